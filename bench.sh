@@ -0,0 +1,95 @@
+#!/bin/sh
+#
+# Boots InfOS headless once for each combination of page allocation and
+# scheduling algorithm, runs the benchmark init program (/usr/bench), and
+# prints the results side by side.  Pass --no-build to skip ./build.sh; any
+# other arguments are appended to the kernel command line.
+#
+# Environment:
+#   QEMU                The QEMU binary
+#   PGALLOC_ALGORITHMS  The page allocation algorithms to run (default: "simple buddy")
+#   SCHED_ALGORITHMS    The scheduling algorithms to run (default: "cfs rr")
+#   BENCH_TIMEOUT       Seconds to allow for each run (default: 600)
+
+TOP=`pwd`
+INFOS_DIRECTORY=$TOP/infos
+ROOTFS=$TOP/infos-user/bin/rootfs.tar
+KERNEL=$INFOS_DIRECTORY/out/infos-kernel
+QEMU=${QEMU:-/afs/inf.ed.ac.uk/group/teaching/cs3/os/qemu/qemu-3.1.0/x86_64-softmmu/qemu-system-x86_64}
+OUT_DIR=$TOP/bench-out
+PGALLOC_ALGORITHMS=${PGALLOC_ALGORITHMS:-"simple buddy"}
+SCHED_ALGORITHMS=${SCHED_ALGORITHMS:-"cfs rr"}
+BENCH_TIMEOUT=${BENCH_TIMEOUT:-600}
+
+if [ "$1" = "--no-build" ]
+  then
+    shift
+  else
+    ./build.sh || exit 1
+fi
+
+mkdir -p $OUT_DIR
+rm -f $OUT_DIR/*.log $OUT_DIR/*.serial
+
+CONFIGS=""
+FAILED=0
+
+for PGALLOC in $PGALLOC_ALGORITHMS; do
+  for SCHED in $SCHED_ALGORITHMS; do
+    CONFIG=$PGALLOC-$SCHED
+    CONFIGS="$CONFIGS $CONFIG"
+    KERNEL_CMDLINE="boot-device=ata0 init=/usr/bench pgalloc.debug=0 pgalloc.algorithm=$PGALLOC objalloc.debug=0 sched.debug=0 sched.algorithm=$SCHED syslog=serial $*"
+
+    echo "Running benchmarks with pgalloc.algorithm=$PGALLOC sched.algorithm=$SCHED..."
+
+    timeout $BENCH_TIMEOUT $QEMU -kernel $KERNEL -m 5G -display none -no-reboot \
+      -debugcon file:$OUT_DIR/$CONFIG.log -serial file:$OUT_DIR/$CONFIG.serial \
+      -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+      -hda $ROOTFS -append "$KERNEL_CMDLINE"
+
+    # isa-debug-exit makes QEMU exit with (code << 1) | 1, and the benchmark
+    # runner writes 0 when it completes.
+    STATUS=$?
+    if [ $STATUS -ne 1 ]
+      then
+        echo "  FAILED (exit status $STATUS), see $OUT_DIR/$CONFIG.serial"
+        FAILED=1
+    fi
+  done
+done
+
+echo
+awk -v configs="$CONFIGS" '
+FNR == 1 {
+  config = FILENAME
+  sub(/.*\//, "", config)
+  sub(/\.log$/, "", config)
+}
+
+$1 == "BENCH" {
+  for (i = 3; i <= NF; i++) {
+    split($i, kv, "=")
+    metric = $2 "." kv[1]
+    if (!(metric in seen)) {
+      seen[metric] = 1
+      order[n++] = metric
+    }
+    value[metric, config] = kv[2]
+  }
+}
+
+END {
+  nc = split(configs, c, " ")
+
+  printf "%-32s", "metric"
+  for (j = 1; j <= nc; j++) printf " %14s", c[j]
+  printf "\n"
+
+  for (i = 0; i < n; i++) {
+    printf "%-32s", order[i]
+    for (j = 1; j <= nc; j++) printf " %14s", ((order[i], c[j]) in value) ? value[order[i], c[j]] : "-"
+    printf "\n"
+  }
+}' $OUT_DIR/*.log | tee $OUT_DIR/results.txt
+
+exit $FAILED
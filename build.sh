@@ -1,6 +1,32 @@
 #!/bin/sh
 
 BASE_DIR=`pwd`
+STATIC_CONFIG=$BASE_DIR/coursework/static-config.h
+
+# Bind algorithms at compile time, if asked to (see coursework/static-algorithms.h).
+# Otherwise, they are selected at boot from the command line.  The configuration is
+# always generated (empty when nothing is bound), since the kernel sources depend on it.
+echo "/* Generated by build.sh */" > $STATIC_CONFIG.tmp
+if [ -n "$STATIC_ALGORITHMS" ]
+  then
+    echo "Binding algorithms at compile time: $STATIC_ALGORITHMS"
+    for ALGORITHM in $STATIC_ALGORITHMS; do
+      case $ALGORITHM in
+        buddy) echo "#define INFOS_STATIC_PGALLOC_BUDDY" >> $STATIC_CONFIG.tmp ;;
+        rr) echo "#define INFOS_STATIC_SCHED_RR" >> $STATIC_CONFIG.tmp ;;
+        *) echo "  ERROR: CANNOT BIND $ALGORITHM STATICALLY"; rm -f $STATIC_CONFIG.tmp; exit 1 ;;
+      esac
+    done
+fi
+
+# Only replace the configuration when it changes, so that an unchanged build is not
+# rebuilt from scratch.
+if cmp -s $STATIC_CONFIG.tmp $STATIC_CONFIG
+  then
+    rm -f $STATIC_CONFIG.tmp
+  else
+    mv $STATIC_CONFIG.tmp $STATIC_CONFIG
+fi
 
 echo "Building infos..."
 
@@ -0,0 +1,97 @@
+/*
+ * Benchmark Reporting
+ *
+ * Benchmarks report their results as lines of the form
+ *
+ *   BENCH <benchmark> <metric>=<value> ...
+ *
+ * on QEMU's debug console, where bench.sh collects them into a comparison
+ * table.  The lines are echoed to the normal console too.
+ */
+#pragma once
+
+// The number of latency samples kept by a BenchSampleBuffer, unless it is given
+// a size
+#define BENCH_DEFAULT_SAMPLES	4096
+
+/**
+ * Returns the current time, in nanoseconds since boot, from the time page.
+ */
+extern unsigned long bench_now();
+
+/**
+ * Collects the latencies of the operations of one benchmark, and reports the
+ * throughput and latency percentiles.  Once the sample buffer is full, further
+ * operations still count towards the throughput, but their latencies are
+ * dropped, so the buffer should be sized to the number of operations.  The
+ * buffer is provided by BenchSampleBuffer, below.
+ */
+class BenchSamples
+{
+public:
+	/**
+	 * Starts the throughput clock, and discards any previous samples.
+	 */
+	void start();
+
+	/**
+	 * Stops the throughput clock.
+	 */
+	void stop();
+
+	/**
+	 * Records the latency of one operation.
+	 * @param ns The latency, in nanoseconds.
+	 */
+	void record(unsigned long ns);
+
+	/**
+	 * Reports ops_per_sec, and the p50/p90/p99/max latencies in nanoseconds, with
+	 * bench_report().  Sorts the samples.
+	 * @param benchmark The name of the benchmark.
+	 */
+	void report(const char *benchmark);
+
+	unsigned long ops() const { return _ops; }
+
+protected:
+	BenchSamples(unsigned long *samples, unsigned int capacity)
+		: _samples(samples), _capacity(capacity), _count(0), _ops(0), _start(0), _end(0) { }
+
+private:
+	unsigned long percentile(unsigned int pc) const;
+
+	unsigned long *_samples;
+	unsigned int _capacity, _count;
+	unsigned long _ops;
+	unsigned long _start, _end;
+};
+
+/**
+ * A BenchSamples with room for the given number of samples.  Large enough that
+ * instances should be static.
+ */
+template<unsigned int Capacity = BENCH_DEFAULT_SAMPLES>
+class BenchSampleBuffer : public BenchSamples
+{
+public:
+	BenchSampleBuffer() : BenchSamples(_buffer, Capacity) { }
+
+private:
+	unsigned long _buffer[Capacity];
+};
+
+/**
+ * Writes one line of results for a benchmark, e.g.
+ * bench_report("exec", "ops_per_sec=%lu", ops).
+ * @param benchmark The name of the benchmark.
+ * @param fmt A printf-style format for the metrics, as space-separated key=value pairs.
+ */
+extern void bench_report(const char *benchmark, const char *fmt, ...);
+
+/**
+ * Shuts down QEMU through the isa-debug-exit device.  Returns only if that
+ * device is not present.
+ * @param code The exit code, which QEMU reports as (code << 1) | 1.
+ */
+extern void bench_exit(unsigned char code);
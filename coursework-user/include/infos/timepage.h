@@ -0,0 +1,28 @@
+/*
+ * Shared Time Page
+ *
+ * Reads the time from the page that the kernel publishes into every process
+ * that asks for it, without a system call.
+ */
+#pragma once
+
+#include <infos/time-page-abi.h>
+
+/**
+ * Maps the kernel's time page into this process.  This is the only call that enters
+ * the kernel; it is made automatically by the first time query.
+ * @return Returns true if the time page is available.
+ */
+extern bool timepage_init();
+
+/**
+ * Returns the number of nanoseconds since boot, or zero if the kernel's clock has not
+ * been calibrated yet.
+ */
+extern unsigned long timepage_monotonic_ns();
+
+/**
+ * Returns the wall-clock time, as nanoseconds since the Unix epoch, or zero if the
+ * kernel's clock has not been calibrated yet.
+ */
+extern unsigned long timepage_realtime_ns();
@@ -0,0 +1,105 @@
+/*
+ * Benchmark Reporting
+ */
+#include <infos.h>
+#include <infos/bench.h>
+#include <infos/timepage.h>
+
+static HFILE debugcon;
+static bool debugcon_opened;
+
+void bench_report(const char *benchmark, const char *fmt, ...)
+{
+	char metrics[192], line[256];
+
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(metrics, sizeof(metrics), fmt, args);
+	va_end(args);
+
+	int n = snprintf(line, sizeof(line), "BENCH %s %s\n", benchmark, metrics);
+	if (n > (int)sizeof(line) - 1) n = sizeof(line) - 1;
+
+	printf("%s", line);
+
+	if (!debugcon_opened) {
+		debugcon = open("/dev/debugcon0", 0);
+		debugcon_opened = true;
+	}
+
+	if (!is_error(debugcon)) {
+		write(debugcon, line, n);
+	}
+}
+
+void bench_exit(unsigned char code)
+{
+	HFILE dev = open("/dev/qemu-exit0", 0);
+	if (is_error(dev)) return;
+
+	write(dev, (const char *)&code, 1);
+	close(dev);
+}
+
+unsigned long bench_now()
+{
+	return timepage_monotonic_ns();
+}
+
+void BenchSamples::start()
+{
+	_count = 0;
+	_ops = 0;
+	_end = 0;
+	_start = bench_now();
+}
+
+void BenchSamples::stop()
+{
+	_end = bench_now();
+}
+
+void BenchSamples::record(unsigned long ns)
+{
+	if (_count < _capacity) {
+		_samples[_count++] = ns;
+	}
+
+	_ops++;
+}
+
+unsigned long BenchSamples::percentile(unsigned int pc) const
+{
+	if (_count == 0) return 0;
+
+	unsigned int index = (_count * pc) / 100;
+	if (index >= _count) index = _count - 1;
+
+	return _samples[index];
+}
+
+void BenchSamples::report(const char *benchmark)
+{
+	// Shell sort the samples, so that the percentiles can be read off directly.
+	for (unsigned int gap = _count / 2; gap > 0; gap /= 2) {
+		for (unsigned int i = gap; i < _count; i++) {
+			unsigned long sample = _samples[i];
+			unsigned int j = i;
+
+			while (j >= gap && _samples[j - gap] > sample) {
+				_samples[j] = _samples[j - gap];
+				j -= gap;
+			}
+
+			_samples[j] = sample;
+		}
+	}
+
+	unsigned long elapsed = (_end > _start) ? _end - _start : 1;
+
+	// There is no libgcc for 128-bit division, but _ops * 10^9 only overflows beyond
+	// 18 billion operations.
+	bench_report(benchmark, "ops_per_sec=%lu p50_ns=%lu p90_ns=%lu p99_ns=%lu max_ns=%lu",
+			_ops * 1000000000 / elapsed,
+			percentile(50), percentile(90), percentile(99), percentile(100));
+}
@@ -0,0 +1,80 @@
+/*
+ * Shared Time Page
+ */
+#include <infos.h>
+#include <infos/timepage.h>
+
+static const TimePageData *time_page;
+
+bool timepage_init()
+{
+	if (time_page) return true;
+
+	HFILE dev = open("/dev/timepage0", 0);
+	if (is_error(dev)) return false;
+
+	unsigned long va = 0;
+	int n = read(dev, (char *)&va, sizeof(va));
+	close(dev);
+
+	if (n != sizeof(va) || va == 0) return false;
+
+	time_page = (const TimePageData *)va;
+	return true;
+}
+
+static inline unsigned long rdtsc()
+{
+	unsigned int lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((unsigned long)hi << 32) | lo;
+}
+
+/**
+ * Takes a consistent snapshot of the time page, and computes the monotonic time from it.
+ * @param real Receives the wall-clock time, if not NULL.
+ * @return Returns the monotonic time, or zero if the clock is not available.
+ */
+static unsigned long read_time(unsigned long *real)
+{
+	if (!time_page && !timepage_init()) return 0;
+
+	TimePageData snapshot;
+	unsigned long seq, tsc;
+
+	do {
+		seq = time_page->seq;
+		asm volatile("" ::: "memory");
+
+		snapshot.tsc_hz = time_page->tsc_hz;
+		snapshot.ns_per_cycle = time_page->ns_per_cycle;
+		snapshot.mono_base_ns = time_page->mono_base_ns;
+		snapshot.mono_base_tsc = time_page->mono_base_tsc;
+		snapshot.real_base_ns = time_page->real_base_ns;
+		snapshot.real_base_mono_ns = time_page->real_base_mono_ns;
+		tsc = rdtsc();
+
+		asm volatile("" ::: "memory");
+	} while ((seq & 1) || seq != time_page->seq);
+
+	if (snapshot.tsc_hz == 0) return 0;
+
+	unsigned long mono = snapshot.mono_base_ns +
+		(unsigned long)(((unsigned __int128)(tsc - snapshot.mono_base_tsc) * snapshot.ns_per_cycle) >> 32);
+
+	if (real) *real = snapshot.real_base_ns + (mono - snapshot.real_base_mono_ns);
+	return mono;
+}
+
+unsigned long timepage_monotonic_ns()
+{
+	return read_time(NULL);
+}
+
+unsigned long timepage_realtime_ns()
+{
+	unsigned long real = 0;
+	read_time(&real);
+
+	return real;
+}
@@ -0,0 +1,74 @@
+/*
+ * Large File Read Benchmark
+ *
+ * Reads files from the root filesystem in fixed-size chunks, repeatedly,
+ * loading the filesystem, block layer and disk driver.  Reads the file named
+ * on the command line, or the benchmark programs themselves by default.
+ */
+#include <infos.h>
+#include <infos/bench.h>
+
+#define CHUNK_SIZE	4096
+#define PASSES		8
+
+static BenchSampleBuffer<> samples;
+static char chunk[CHUNK_SIZE];
+
+static const char *default_files[] = {
+	"/usr/bench",
+	"/usr/bench-procs",
+	"/usr/bench-pingpong",
+	"/usr/bench-memtouch",
+	"/usr/bench-fileread",
+	"/usr/bench-sleep",
+	NULL,
+};
+
+/**
+ * Reads a whole file, recording the latency of each chunk.
+ * @return Returns the number of bytes read.
+ */
+static unsigned long read_file(const char *path)
+{
+	HFILE file = open(path, 0);
+	if (is_error(file)) {
+		printf("bench-fileread: unable to open %s\n", path);
+		return 0;
+	}
+
+	unsigned long total = 0;
+
+	while (true) {
+		unsigned long start = bench_now();
+		int n = read(file, chunk, CHUNK_SIZE);
+
+		if (n <= 0) break;
+
+		samples.record(bench_now() - start);
+		total += n;
+	}
+
+	close(file);
+	return total;
+}
+
+int main(const char *cmdline)
+{
+	const char *single[] = { cmdline, NULL };
+	const char **files = (cmdline && *cmdline) ? single : default_files;
+
+	unsigned long total = 0;
+
+	samples.start();
+	for (unsigned int pass = 0; pass < PASSES; pass++) {
+		for (unsigned int i = 0; files[i]; i++) {
+			total += read_file(files[i]);
+		}
+	}
+	samples.stop();
+
+	samples.report("fileread");
+	bench_report("fileread", "bytes=%lu", total);
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Memory Touch Benchmark
+ *
+ * Sweeps a large, zero-initialised region one page at a time.  The first
+ * sweep takes the page faults (and page allocations) that back the region;
+ * the second measures the cost of touching pages that are already mapped.
+ */
+#include <infos.h>
+#include <infos/bench.h>
+
+#define PAGE_SIZE		0x1000
+#define REGION_SIZE		(32 * 1024 * 1024)
+#define REGION_PAGES	(REGION_SIZE / PAGE_SIZE)
+
+// One sample per page, so that the percentiles cover the whole region.
+static BenchSampleBuffer<REGION_PAGES> samples;
+static char region[REGION_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static void sweep(const char *benchmark)
+{
+	samples.start();
+	for (unsigned long offset = 0; offset < REGION_SIZE; offset += PAGE_SIZE) {
+		unsigned long start = bench_now();
+
+		*(volatile char *)&region[offset] += 1;
+
+		samples.record(bench_now() - start);
+	}
+	samples.stop();
+	samples.report(benchmark);
+}
+
+int main(const char *cmdline)
+{
+	sweep("memtouch-first");
+	sweep("memtouch-warm");
+
+	return 0;
+}
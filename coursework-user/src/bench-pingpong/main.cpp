@@ -0,0 +1,92 @@
+/*
+ * Thread Ping-pong Benchmark
+ *
+ * Two long-lived threads hand a token back and forth.  The thread without the
+ * token gives up the CPU with a zero-length sleep, which blocks it in the
+ * kernel until it is next scheduled, so every hand-over costs a block, a
+ * wake-up and a context switch.  (InfOS user space has no blocking primitive
+ * between threads other than join_thread, which only fires once.)
+ *
+ * The cost of starting a thread and joining it once it has exited is reported
+ * separately, as "thread-spawn".
+ */
+#include <infos.h>
+#include <infos/bench.h>
+
+#define ROUND_TRIPS	2000
+#define SPAWNS		500
+
+static BenchSampleBuffer<ROUND_TRIPS> rounds;
+static BenchSampleBuffer<SPAWNS> spawns;
+static volatile unsigned int turn;
+
+static void wait_for_turn(unsigned int me)
+{
+	while (turn != me) {
+		usleep(0);
+	}
+}
+
+static void pong(void *arg)
+{
+	for (unsigned int i = 0; i < ROUND_TRIPS; i++) {
+		wait_for_turn(1);
+		turn = 0;
+	}
+}
+
+static void nothing(void *arg)
+{
+}
+
+static bool ping_pong()
+{
+	turn = 0;
+
+	HTHREAD thread = create_thread(pong, NULL);
+	if (is_error(thread)) return false;
+
+	rounds.start();
+	for (unsigned int i = 0; i < ROUND_TRIPS; i++) {
+		unsigned long start = bench_now();
+
+		turn = 1;
+		wait_for_turn(0);
+
+		rounds.record(bench_now() - start);
+	}
+	rounds.stop();
+
+	join_thread(thread);
+	return true;
+}
+
+static bool spawn()
+{
+	spawns.start();
+	for (unsigned int i = 0; i < SPAWNS; i++) {
+		unsigned long start = bench_now();
+
+		HTHREAD thread = create_thread(nothing, NULL);
+		if (is_error(thread)) return false;
+
+		join_thread(thread);
+		spawns.record(bench_now() - start);
+	}
+	spawns.stop();
+
+	return true;
+}
+
+int main(const char *cmdline)
+{
+	if (!ping_pong() || !spawn()) {
+		printf("bench-pingpong: unable to create a thread\n");
+		return 1;
+	}
+
+	rounds.report("pingpong");
+	spawns.report("thread-spawn");
+
+	return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * Process Storm Benchmark
+ *
+ * Launches and reaps short-lived processes, one at a time and then in
+ * batches, to load process creation and teardown: address-space setup, page
+ * allocation and freeing, and the scheduler's runqueue.
+ */
+#include <infos.h>
+#include <infos/bench.h>
+
+#define SERIAL_ITERATIONS	200
+#define BATCH_ITERATIONS	25
+#define BATCH_SIZE			8
+
+static BenchSampleBuffer<> samples;
+
+int main(const char *cmdline)
+{
+	// Each process launched by the benchmark is this program, doing nothing.
+	if (cmdline && strcmp(cmdline, "child") == 0) return 0;
+
+	// One at a time: the latency of a launch, run and exit.
+	samples.start();
+	for (unsigned int i = 0; i < SERIAL_ITERATIONS; i++) {
+		unsigned long start = bench_now();
+
+		HPROC child = exec("/usr/bench-procs", "child");
+		if (is_error(child)) {
+			printf("bench-procs: unable to launch a child\n");
+			return 1;
+		}
+
+		wait_proc(child);
+		samples.record(bench_now() - start);
+	}
+	samples.stop();
+	samples.report("procs-serial");
+
+	// In batches: the latency of a whole batch, counted per process.
+	samples.start();
+	for (unsigned int i = 0; i < BATCH_ITERATIONS; i++) {
+		HPROC children[BATCH_SIZE];
+		unsigned long start = bench_now();
+
+		for (unsigned int j = 0; j < BATCH_SIZE; j++) {
+			children[j] = exec("/usr/bench-procs", "child");
+		}
+
+		for (unsigned int j = 0; j < BATCH_SIZE; j++) {
+			if (!is_error(children[j])) wait_proc(children[j]);
+		}
+
+		unsigned long elapsed = bench_now() - start;
+		for (unsigned int j = 0; j < BATCH_SIZE; j++) {
+			samples.record(elapsed);
+		}
+	}
+	samples.stop();
+	samples.report("procs-batch");
+
+	return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * Sleep/Wake-up Storm Benchmark
+ *
+ * Many threads sleep for a short period over and over, so that the kernel
+ * has a crowd of sleepers to keep track of and wake on time.  The latency
+ * recorded is the oversleep: how much later than requested each thread ran
+ * again.
+ */
+#include <infos.h>
+#include <infos/bench.h>
+
+#define NR_THREADS		16
+#define SLEEPS			100
+#define SLEEP_US		1000
+
+// Each thread records into its own slice of the samples, merged at the end.
+static unsigned long oversleep[NR_THREADS][SLEEPS];
+static BenchSampleBuffer<> samples;
+
+static void sleeper(void *arg)
+{
+	unsigned long *out = (unsigned long *)arg;
+
+	for (unsigned int i = 0; i < SLEEPS; i++) {
+		unsigned long start = bench_now();
+		usleep(SLEEP_US);
+		unsigned long slept = bench_now() - start;
+
+		out[i] = slept > SLEEP_US * 1000 ? slept - SLEEP_US * 1000 : 0;
+	}
+}
+
+int main(const char *cmdline)
+{
+	HTHREAD threads[NR_THREADS];
+
+	samples.start();
+	for (unsigned int i = 0; i < NR_THREADS; i++) {
+		threads[i] = create_thread(sleeper, oversleep[i]);
+	}
+
+	for (unsigned int i = 0; i < NR_THREADS; i++) {
+		if (!is_error(threads[i])) join_thread(threads[i]);
+	}
+	samples.stop();
+
+	for (unsigned int i = 0; i < NR_THREADS; i++) {
+		if (is_error(threads[i])) continue;
+
+		for (unsigned int j = 0; j < SLEEPS; j++) {
+			samples.record(oversleep[i][j]);
+		}
+	}
+
+	samples.report("sleep");
+
+	return 0;
+}
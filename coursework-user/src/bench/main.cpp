@@ -0,0 +1,89 @@
+/*
+ * Benchmark Runner
+ *
+ * Boot with init=/usr/bench to run the benchmarks one after the other, report
+ * the results on QEMU's debug console, and shut QEMU down.  Used by bench.sh.
+ * The kernel's boot timeline is put on the debug console first, by reading
+ * the boot-trace device.
+ */
+#include <infos.h>
+#include <infos/bench.h>
+#include <infos/timepage.h>
+
+// How long to wait for the kernel to calibrate its clock: the first calibration
+// needs two RTC update-ended interrupts, so it can take up to two seconds after the
+// RTC driver starts.
+#define CALIBRATION_TIMEOUT_MS	5000
+#define CALIBRATION_POLL_MS		50
+
+// The benchmark programs, run in order
+static const char *benchmarks[] = {
+	"/usr/bench-procs",
+	"/usr/bench-pingpong",
+	"/usr/bench-memtouch",
+	"/usr/bench-fileread",
+	"/usr/bench-sleep",
+	NULL,
+};
+
+/**
+ * Waits for the kernel's clock to be calibrated, so that the benchmarks can time
+ * themselves.
+ * @return Returns false if the clock was not calibrated in time.
+ */
+static bool wait_for_clock()
+{
+	for (unsigned int waited = 0; waited < CALIBRATION_TIMEOUT_MS; waited += CALIBRATION_POLL_MS) {
+		if (timepage_monotonic_ns() != 0) return true;
+		usleep(CALIBRATION_POLL_MS * 1000);
+	}
+
+	return timepage_monotonic_ns() != 0;
+}
+
+/**
+ * Reads the boot-trace device, which writes the boot timeline to the debug console
+ * the first time it is read.
+ */
+static void emit_boot_trace()
+{
+	HFILE dev = open("/dev/boot-trace0", 0);
+	if (is_error(dev)) return;
+
+	char buffer[512];
+	while (read(dev, buffer, sizeof(buffer)) > 0);
+
+	close(dev);
+}
+
+int main(const char *cmdline)
+{
+	if (!timepage_init()) {
+		printf("bench: the time page is not available\n");
+		bench_exit(1);
+		return 1;
+	}
+
+	if (!wait_for_clock()) {
+		printf("bench: the kernel's clock was not calibrated within %u ms\n", CALIBRATION_TIMEOUT_MS);
+		bench_exit(1);
+		return 1;
+	}
+
+	emit_boot_trace();
+
+	bench_report("boot", "uptime_ms=%lu", timepage_monotonic_ns() / 1000000);
+
+	for (unsigned int i = 0; benchmarks[i]; i++) {
+		HPROC proc = exec(benchmarks[i], NULL);
+		if (is_error(proc)) {
+			printf("bench: unable to launch %s\n", benchmarks[i]);
+			continue;
+		}
+
+		wait_proc(proc);
+	}
+
+	bench_exit(0);
+	return 0;
+}
@@ -0,0 +1,476 @@
+/*
+ * ATA Bus-master DMA
+ *
+ * A block device for the primary master ATA disk that transfers by PCI IDE
+ * bus-master DMA, rather than PIO: the controller copies up to
+ * DMA_MAX_SECTORS sectors per command directly to or from a physically
+ * contiguous bounce buffer, described to it by a physical region descriptor
+ * (PRD) table, and raises IRQ 14 when it is done.  The thread that issued the
+ * command sleeps until then, and polls the controller if the interrupt does
+ * not arrive, or if nothing drives the sleep wheel.  A command that has not
+ * completed by then fails with an error.
+ *
+ * It is a separate device from the PIO driver's ata0, so the two can be
+ * benchmarked against each other: boot with boot-device=atadma0 (or with
+ * blockcache.device=atadma0) to use DMA.  Only one of the two should be used
+ * at a time, as they drive the same channel, so the controller is only probed,
+ * and IRQ 14 only claimed, when atadma0 is first used.
+ */
+#include <infos/drivers/block/block-device.h>
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/irq.h>
+#include <infos/kernel/log.h>
+#include <infos/mm/mm.h>
+#include <infos/mm/page-allocator.h>
+#include <infos/util/lock.h>
+#include <infos/util/string.h>
+#include <arch/x86/pio.h>
+#include <arch/x86/x86-arch.h>
+
+#include "thread-sleep.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::drivers::block;
+using namespace infos::mm;
+using namespace infos::util;
+using namespace infos::arch::x86;
+
+#define PCI_CONFIG_ADDRESS		0xCF8
+#define PCI_CONFIG_DATA			0xCFC
+
+#define PCI_REG_COMMAND			0x04
+#define PCI_REG_CLASS			0x08
+#define PCI_REG_BAR4			0x20
+
+#define PCI_COMMAND_IO			0x01
+#define PCI_COMMAND_BUS_MASTER	0x04
+
+// The primary ATA channel
+#define ATA_IO_BASE				0x1F0
+#define ATA_CONTROL				0x3F6
+#define ATA_IRQ					14
+
+#define ATA_REG_SECTOR_COUNT	2
+#define ATA_REG_LBA_LOW			3
+#define ATA_REG_LBA_MID			4
+#define ATA_REG_LBA_HIGH		5
+#define ATA_REG_DRIVE			6
+#define ATA_REG_STATUS			7
+#define ATA_REG_COMMAND			7
+
+#define ATA_STATUS_ERR			0x01
+#define ATA_STATUS_DRQ			0x08
+#define ATA_STATUS_DF			0x20
+#define ATA_STATUS_BSY			0x80
+
+#define ATA_CMD_READ_DMA		0xC8
+#define ATA_CMD_WRITE_DMA		0xCA
+#define ATA_CMD_IDENTIFY		0xEC
+
+// Bus-master registers, relative to BAR4
+#define BM_REG_COMMAND			0
+#define BM_REG_STATUS			2
+#define BM_REG_PRDT				4
+
+#define BM_COMMAND_START		0x01
+#define BM_COMMAND_TO_MEMORY	0x08
+
+#define BM_STATUS_ACTIVE		0x01
+#define BM_STATUS_ERROR			0x02
+#define BM_STATUS_IRQ			0x04
+
+#define SECTOR_SIZE				512
+
+// How long to wait for a command to complete, before giving up on its interrupt: 1s
+#define DMA_TIMEOUT_NS			1000000000ull
+
+// How many times to poll the controller for completion when the wait cannot sleep
+// (each poll is a port read, so this is of the order of a second).
+#define DMA_POLL_LIMIT			1000000
+
+// One command moves at most 256 sectors (a sector count of zero), i.e. 128KB.
+#define DMA_MAX_SECTORS			256
+#define DMA_BUFFER_ORDER		5
+
+// The last PRD in the table has this bit set in its flags.
+#define PRD_END_OF_TABLE		0x8000
+
+/**
+ * A physical region descriptor: one physically contiguous piece of a transfer, which
+ * must not cross a 64KB boundary.  A byte count of zero means 64KB.
+ */
+struct PhysicalRegionDescriptor
+{
+	uint32_t address;
+	uint16_t byte_count;
+	uint16_t flags;
+} __attribute__((packed));
+
+class ATADMADevice : public BlockDevice
+{
+public:
+	static const DeviceClass ATADMADeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return ATADMADeviceClass;
+	}
+
+	ATADMADevice() : _probed(false), _ready(false), _bm_base(0), _nr_sectors(0), _prdt(NULL), _prdt_pa(0),
+		_buffer(NULL), _buffer_pa(0), _bm_status(0), _complete(false), _waiter(NULL) { }
+
+	bool init(DeviceManager& dm) override
+	{
+		// Nothing is touched until the device is first used; see ready().
+		return true;
+	}
+
+	size_t block_size() const override
+	{
+		return SECTOR_SIZE;
+	}
+
+	size_t block_count() const override
+	{
+		return ready() ? _nr_sectors : 0;
+	}
+
+	int read_blocks(void *buffer, size_t offset, size_t count) override
+	{
+		if (!ready() || offset + count > _nr_sectors) return -1;
+
+		UniqueLock<Mutex> l(_mtx);
+		uint8_t *out = (uint8_t *)buffer;
+
+		for (size_t done = 0; done < count; ) {
+			size_t n = count - done;
+			if (n > DMA_MAX_SECTORS) n = DMA_MAX_SECTORS;
+
+			if (!transfer(false, offset + done, n)) return -1;
+			memcpy(out + (done * SECTOR_SIZE), _buffer, n * SECTOR_SIZE);
+
+			done += n;
+		}
+
+		return count;
+	}
+
+	int write_blocks(const void *buffer, size_t offset, size_t count) override
+	{
+		if (!ready() || offset + count > _nr_sectors) return -1;
+
+		UniqueLock<Mutex> l(_mtx);
+		const uint8_t *in = (const uint8_t *)buffer;
+
+		for (size_t done = 0; done < count; ) {
+			size_t n = count - done;
+			if (n > DMA_MAX_SECTORS) n = DMA_MAX_SECTORS;
+
+			memcpy(_buffer, in + (done * SECTOR_SIZE), n * SECTOR_SIZE);
+			if (!transfer(true, offset + done, n)) return -1;
+
+			done += n;
+		}
+
+		return count;
+	}
+
+private:
+	/**
+	 * Returns TRUE if the device can be used, probing the controller and the disk the
+	 * first time it is called.
+	 */
+	bool ready() const
+	{
+		UniqueLock<Mutex> l(_mtx);
+
+		if (!_probed) {
+			_probed = true;
+			_ready = const_cast<ATADMADevice *>(this)->probe();
+		}
+
+		return _ready;
+	}
+
+	/**
+	 * Finds the controller and the disk, sets up the DMA buffers, and claims the
+	 * channel's interrupt.
+	 */
+	bool probe()
+	{
+		if (!find_controller()) {
+			syslog.messagef(LogLevel::WARNING, "atadma: no bus-mastering IDE controller found");
+			return false;
+		}
+
+		if (!identify()) {
+			syslog.messagef(LogLevel::WARNING, "atadma: no disk on the primary master");
+			return false;
+		}
+
+		// The controller only takes 32-bit physical addresses, for both the PRD table and
+		// the buffer.
+		PageDescriptor *prdt_pgd = infos::kernel::sys.mm().pgalloc().alloc_pages(0);
+		PageDescriptor *buffer_pgd = infos::kernel::sys.mm().pgalloc().alloc_pages(DMA_BUFFER_ORDER);
+
+		if (!prdt_pgd || !buffer_pgd) {
+			syslog.messagef(LogLevel::ERROR, "atadma: unable to allocate the dma buffers");
+			return false;
+		}
+
+		_prdt_pa = infos::kernel::sys.mm().pgalloc().pgd_to_pfn(prdt_pgd) << 12;
+		_buffer_pa = infos::kernel::sys.mm().pgalloc().pgd_to_pfn(buffer_pgd) << 12;
+
+		if ((_prdt_pa >> 32) || ((_buffer_pa + (DMA_MAX_SECTORS * SECTOR_SIZE) - 1) >> 32)) {
+			syslog.messagef(LogLevel::ERROR, "atadma: dma buffers are out of reach of the controller");
+			return false;
+		}
+
+		_prdt = (PhysicalRegionDescriptor *)infos::kernel::sys.mm().pgalloc().pgd_to_vpa(prdt_pgd);
+		_buffer = (uint8_t *)infos::kernel::sys.mm().pgalloc().pgd_to_vpa(buffer_pgd);
+
+		IRQ *irq = infos::arch::x86::sys.irq_manager().request_physical_irq(ATA_IRQ, ata_irq_handler, this);
+		if (!irq) {
+			syslog.messagef(LogLevel::ERROR, "atadma: unable to claim irq %u", ATA_IRQ);
+			return false;
+		}
+
+		// Let the drive raise interrupts.
+		__outb(ATA_CONTROL, 0);
+
+		syslog.messagef(LogLevel::INFO, "atadma: %lu sectors, bus master at %x", _nr_sectors, _bm_base);
+		return true;
+	}
+
+	static uint32_t pci_read(uint8_t bus, uint8_t device, uint8_t function, uint8_t reg)
+	{
+		__outl(PCI_CONFIG_ADDRESS, 0x80000000u | (bus << 16) | (device << 11) | (function << 8) | (reg & 0xFC));
+		return __inl(PCI_CONFIG_DATA);
+	}
+
+	static void pci_write(uint8_t bus, uint8_t device, uint8_t function, uint8_t reg, uint32_t value)
+	{
+		__outl(PCI_CONFIG_ADDRESS, 0x80000000u | (bus << 16) | (device << 11) | (function << 8) | (reg & 0xFC));
+		__outl(PCI_CONFIG_DATA, value);
+	}
+
+	/**
+	 * Looks on PCI bus 0 for an IDE controller that can bus master, and enables bus
+	 * mastering on it.
+	 */
+	bool find_controller()
+	{
+		for (unsigned int device = 0; device < 32; device++) {
+			for (unsigned int function = 0; function < 8; function++) {
+				if ((pci_read(0, device, function, 0) & 0xFFFF) == 0xFFFF) continue;
+
+				// Mass storage (01), IDE (01), with the bus-master bit set in the interface.
+				uint32_t class_code = pci_read(0, device, function, PCI_REG_CLASS);
+				if ((class_code >> 16) != 0x0101 || !(class_code & (0x80 << 8))) continue;
+
+				_bm_base = pci_read(0, device, function, PCI_REG_BAR4) & 0xFFFC;
+				if (!_bm_base) continue;
+
+				uint32_t command = pci_read(0, device, function, PCI_REG_COMMAND);
+				pci_write(0, device, function, PCI_REG_COMMAND, command | PCI_COMMAND_IO | PCI_COMMAND_BUS_MASTER);
+
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	/**
+	 * Waits for the drive to finish what it is doing.
+	 * @return Returns the final status, or zero if the drive did not respond.
+	 */
+	static uint8_t wait_not_busy()
+	{
+		for (unsigned int i = 0; i < 1000000; i++) {
+			uint8_t status = __inb(ATA_IO_BASE + ATA_REG_STATUS);
+			if (status == 0xFF) return 0;
+			if (!(status & ATA_STATUS_BSY)) return status;
+		}
+
+		return 0;
+	}
+
+	/**
+	 * Identifies the primary master, by PIO, to find out its size.
+	 */
+	bool identify()
+	{
+		__outb(ATA_IO_BASE + ATA_REG_DRIVE, 0xA0);
+		__outb(ATA_IO_BASE + ATA_REG_SECTOR_COUNT, 0);
+		__outb(ATA_IO_BASE + ATA_REG_LBA_LOW, 0);
+		__outb(ATA_IO_BASE + ATA_REG_LBA_MID, 0);
+		__outb(ATA_IO_BASE + ATA_REG_LBA_HIGH, 0);
+		__outb(ATA_IO_BASE + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+
+		uint8_t status = wait_not_busy();
+		if (!status || (status & ATA_STATUS_ERR) || !(status & ATA_STATUS_DRQ)) return false;
+
+		uint16_t data[256];
+		for (unsigned int i = 0; i < ARRAY_SIZE(data); i++) {
+			data[i] = __inw(ATA_IO_BASE);
+		}
+
+		// Words 60-61 hold the number of sectors addressable with 28-bit LBA.
+		_nr_sectors = data[60] | ((uint32_t)data[61] << 16);
+		return _nr_sectors != 0;
+	}
+
+	/**
+	 * Moves sectors between the disk and the bounce buffer.
+	 * @param write TRUE to write to the disk, FALSE to read from it.
+	 * @param lba The first sector.
+	 * @param count The number of sectors, at most DMA_MAX_SECTORS.
+	 */
+	bool transfer(bool write, size_t lba, size_t count)
+	{
+		// Describe the buffer to the controller, splitting it at 64KB boundaries.
+		uint64_t pa = _buffer_pa;
+		size_t remaining = count * SECTOR_SIZE;
+		unsigned int nr_prds = 0;
+
+		while (remaining > 0) {
+			size_t length = 0x10000 - (pa & 0xFFFF);
+			if (length > remaining) length = remaining;
+
+			_prdt[nr_prds].address = (uint32_t)pa;
+			_prdt[nr_prds].byte_count = (uint16_t)length;		// 64KB wraps to zero
+			_prdt[nr_prds].flags = 0;
+			nr_prds++;
+
+			pa += length;
+			remaining -= length;
+		}
+
+		_prdt[nr_prds - 1].flags = PRD_END_OF_TABLE;
+
+		// Set up the bus master, and clear its error and interrupt bits.
+		__outb(_bm_base + BM_REG_COMMAND, 0);
+		__outl(_bm_base + BM_REG_PRDT, (uint32_t)_prdt_pa);
+		__outb(_bm_base + BM_REG_STATUS, BM_STATUS_ERROR | BM_STATUS_IRQ);
+
+		if (!wait_not_busy()) return false;
+
+		_complete = false;
+		_waiter = &Thread::current();
+
+		__outb(ATA_IO_BASE + ATA_REG_DRIVE, 0xE0 | ((lba >> 24) & 0x0F));
+		__outb(ATA_IO_BASE + ATA_REG_SECTOR_COUNT, count & 0xFF);
+		__outb(ATA_IO_BASE + ATA_REG_LBA_LOW, lba & 0xFF);
+		__outb(ATA_IO_BASE + ATA_REG_LBA_MID, (lba >> 8) & 0xFF);
+		__outb(ATA_IO_BASE + ATA_REG_LBA_HIGH, (lba >> 16) & 0xFF);
+		__outb(ATA_IO_BASE + ATA_REG_COMMAND, write ? ATA_CMD_WRITE_DMA : ATA_CMD_READ_DMA);
+
+		__outb(_bm_base + BM_REG_COMMAND, BM_COMMAND_START | (write ? 0 : BM_COMMAND_TO_MEMORY));
+
+		// Sleep until the interrupt handler signals completion.  The sleep can only time out
+		// if the sleep wheel is being driven, so if it is not, or if the interrupt has not
+		// arrived by the deadline (it may have been lost), poll the controller directly,
+		// which does not depend on the scheduler.
+		unsigned int polls = DMA_POLL_LIMIT;
+
+		if (sleep_clock_running()) {
+			uint64_t deadline = infos::kernel::sys.runtime().count() + DMA_TIMEOUT_NS;
+
+			while (true) {
+				UniqueIRQLock l;
+
+				if (_complete || !sleep_current(deadline)) break;
+			}
+
+			polls = 1;
+		}
+
+		bool timed_out = !poll_complete(polls);
+
+		_waiter = NULL;
+		__outb(_bm_base + BM_REG_COMMAND, 0);
+
+		if (timed_out) {
+			syslog.messagef(LogLevel::ERROR, "atadma: %s of %lu sectors at %lu timed out",
+					write ? "write" : "read", count, lba);
+			return false;
+		}
+
+		uint8_t bm_status = _bm_status;
+		uint8_t status = __inb(ATA_IO_BASE + ATA_REG_STATUS);
+
+		if ((bm_status & BM_STATUS_ERROR) || (status & (ATA_STATUS_ERR | ATA_STATUS_DF))) {
+			syslog.messagef(LogLevel::ERROR, "atadma: %s of %lu sectors at %lu failed (bm=%x, status=%x)",
+					write ? "write" : "read", count, lba, bm_status, status);
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * If the controller has finished the current command, acknowledges its interrupt
+	 * and marks the command complete.  Called with interrupts disabled.
+	 * @return Returns TRUE if the command has completed.
+	 */
+	bool acknowledge()
+	{
+		uint8_t bm_status = __inb(_bm_base + BM_REG_STATUS);
+		if (!(bm_status & BM_STATUS_IRQ)) return false;
+
+		// Reading the drive's status register acknowledges its interrupt, and writing the
+		// bits back clears them in the bus master.
+		__inb(ATA_IO_BASE + ATA_REG_STATUS);
+		__outb(_bm_base + BM_REG_STATUS, BM_STATUS_ERROR | BM_STATUS_IRQ);
+
+		_bm_status = bm_status;
+		_complete = true;
+		return true;
+	}
+
+	/**
+	 * Polls the controller until the current command completes, or the polls run out.
+	 * @return Returns TRUE if the command has completed.
+	 */
+	bool poll_complete(unsigned int polls)
+	{
+		for (unsigned int i = 0; i < polls; i++) {
+			UniqueIRQLock l;
+
+			if (_complete || acknowledge()) return true;
+		}
+
+		return false;
+	}
+
+	static void ata_irq_handler(const IRQ *irq, void *priv)
+	{
+		ATADMADevice *dev = (ATADMADevice *)priv;
+
+		if (dev->acknowledge() && dev->_waiter) {
+			wake_thread(*dev->_waiter);
+		}
+	}
+
+	mutable bool _probed, _ready;
+	mutable Mutex _mtx;
+
+	uint16_t _bm_base;
+	uint64_t _nr_sectors;
+
+	PhysicalRegionDescriptor *_prdt;
+	uint64_t _prdt_pa;
+
+	uint8_t *_buffer;
+	uint64_t _buffer_pa;
+
+	volatile uint8_t _bm_status;
+	volatile bool _complete;
+	Thread * volatile _waiter;		// The thread waiting for the current command
+};
+
+const DeviceClass ATADMADevice::ATADMADeviceClass(BlockDevice::BlockDeviceClass, "atadma");
+
+RegisterDevice(ATADMADevice);
@@ -0,0 +1,63 @@
+/*
+ * Backing Devices
+ *
+ * For block devices that sit in front of another one (the block cache and the
+ * block queue): the name of the device behind them, which can be set on the
+ * command line, and its lookup on first use, so that it need not have been
+ * initialised first.
+ */
+#pragma once
+
+#include <infos/drivers/block/block-device.h>
+#include <infos/drivers/device-manager.h>
+#include <infos/kernel/log.h>
+
+class BackingDevice
+{
+public:
+	/**
+	 * @param owner The name of the device in front, for error messages.
+	 * @param default_name The name of the backing device, unless one is set.
+	 */
+	constexpr BackingDevice(const char *owner, const char *default_name)
+		: _owner(owner), _name(), _device(NULL)
+	{
+		set_name(default_name);
+	}
+
+	/**
+	 * Sets the name of the backing device, e.g. from a command-line argument.
+	 * Names that are too long are truncated.
+	 */
+	constexpr void set_name(const char *name)
+	{
+		unsigned int i;
+		for (i = 0; name[i] && i < sizeof(_name) - 1; i++) {
+			_name[i] = name[i];
+		}
+		_name[i] = 0;
+	}
+
+	const char *name() const { return _name; }
+
+	/**
+	 * Returns the backing device, looking it up the first time it is needed.
+	 * @return Returns the device, or NULL if there is no device with the name.
+	 */
+	infos::drivers::block::BlockDevice *resolve(infos::drivers::DeviceManager& dm)
+	{
+		if (!_device) {
+			if (!dm.try_get_device_by_name(_name, _device)) {
+				infos::kernel::syslog.messagef(infos::kernel::LogLevel::ERROR, "%s: backing device %s not found", _owner, _name);
+				return NULL;
+			}
+		}
+
+		return _device;
+	}
+
+private:
+	const char *_owner;
+	char _name[16];
+	infos::drivers::block::BlockDevice *_device;
+};
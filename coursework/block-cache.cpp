@@ -0,0 +1,433 @@
+/*
+ * Block Cache
+ *
+ * A block device that caches another, page by page, so that repeated reads of
+ * the same blocks (e.g. the rootfs blocks of a program that is exec'd over and
+ * over) are served from memory instead of the disk.  Cache pages come from the
+ * page allocator, up to a limit, after which the least recently used page is
+ * recycled.  A run of misses on consecutive pages is treated as a sequential
+ * read, and the cache reads further ahead each time, up to READAHEAD_MAX_PAGES
+ * in a single request to the backing device.  Writes go straight through to
+ * the backing device, and update any cached copy.
+ *
+ * Boot with boot-device=blockcache0 to load the rootfs through the cache.  The
+ * backing device is ata0 unless blockcache.device is given, and is looked up
+ * on first use, so that it need not be initialised before the cache.
+ */
+#include <infos/drivers/block/block-device.h>
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/mm/mm.h>
+#include <infos/mm/page-allocator.h>
+#include <infos/util/cmdline.h>
+#include <infos/util/lock.h>
+#include <infos/util/string.h>
+
+#include "backing-device.h"
+#include "boot-trace.h"
+#include "log-ring.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::drivers::block;
+using namespace infos::mm;
+using namespace infos::util;
+
+#define CACHE_PAGE_SIZE			0x1000
+
+// The most pages the cache can hold, and how many it holds by default
+#define MAX_CACHE_PAGES			4096
+#define DEFAULT_CACHE_PAGES		1024
+
+#define NR_HASH_BUCKETS			256
+
+// Read-ahead starts at this many pages, and doubles on each sequential miss.
+#define READAHEAD_MIN_PAGES		2
+#define READAHEAD_MAX_PAGES		32
+#define READAHEAD_ORDER			5		// log2(READAHEAD_MAX_PAGES)
+
+// Log the hit rate every this many misses
+#define STATS_INTERVAL			1024
+
+static BackingDevice backing_device("blockcache", "ata0");
+static unsigned int cache_page_limit = DEFAULT_CACHE_PAGES;
+
+RegisterCmdLineArgument(BlockCacheBacking, "blockcache.device") {
+	backing_device.set_name(value);
+}
+
+RegisterCmdLineArgument(BlockCachePages, "blockcache.pages") {
+	unsigned int pages = 0;
+	for (unsigned int i = 0; value[i] >= '0' && value[i] <= '9'; i++) {
+		pages = (pages * 10) + (value[i] - '0');
+	}
+
+	// The cache must at least hold a whole read-ahead, as well as the page being read.
+	if (pages > READAHEAD_MAX_PAGES && pages <= MAX_CACHE_PAGES) {
+		cache_page_limit = pages;
+	}
+}
+
+// Time spent waiting for the backing device
+static BootTraceCounter backing_read_trace("blockcache.backing_read");
+
+/**
+ * One page of cached blocks.
+ */
+struct CacheEntry
+{
+	uint64_t page;				// The index of the page on the backing device
+	uint8_t *data;
+	PageDescriptor *pgd;
+
+	CacheEntry *hash_next;		// Next entry in the same hash bucket
+	CacheEntry *lru_prev;		// Towards the most recently used entry
+	CacheEntry *lru_next;		// Towards the least recently used entry
+};
+
+class BlockCacheDevice : public BlockDevice
+{
+public:
+	static const DeviceClass BlockCacheDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return BlockCacheDeviceClass;
+	}
+
+	BlockCacheDevice()
+		: _dm(NULL), _nr_entries(0), _lru_head(NULL), _lru_tail(NULL),
+		_staging(NULL), _next_sequential(0), _readahead(READAHEAD_MIN_PAGES),
+		_hits(0), _misses(0), _evictions(0)
+	{
+		for (unsigned int i = 0; i < NR_HASH_BUCKETS; i++) {
+			_buckets[i] = NULL;
+		}
+	}
+
+	bool init(DeviceManager& dm) override
+	{
+		_dm = &dm;
+
+		syslog.messagef(LogLevel::INFO, "blockcache: caching %s, up to %u pages",
+				backing_device.name(), cache_page_limit);
+		return true;
+	}
+
+	size_t block_size() const override
+	{
+		BlockDevice *backing = resolve_backing();
+		return backing ? backing->block_size() : 0;
+	}
+
+	size_t block_count() const override
+	{
+		BlockDevice *backing = resolve_backing();
+		return backing ? backing->block_count() : 0;
+	}
+
+	int read_blocks(void *buffer, size_t offset, size_t count) override
+	{
+		BlockDevice *backing = resolve_backing();
+		if (!backing || !in_range(backing, offset, count)) return -1;
+
+		size_t bs = backing->block_size();
+		size_t blocks_per_page = CACHE_PAGE_SIZE / bs;
+		uint8_t *out = (uint8_t *)buffer;
+		size_t remaining = count;
+
+		UniqueLock<Mutex> l(_mtx);
+
+		while (remaining > 0) {
+			uint64_t page = offset / blocks_per_page;
+			size_t first = offset % blocks_per_page;
+			size_t n = blocks_per_page - first;
+			if (n > remaining) n = remaining;
+
+			CacheEntry *entry = lookup(page);
+			if (entry) {
+				_hits++;
+			} else {
+				_misses++;
+
+				entry = fill(backing, page);
+				if (!entry) return -1;
+
+				if ((_misses % STATS_INTERVAL) == 0) {
+					klog(syslog, LogLevel::DEBUG, "blockcache: %lu hits, %lu misses, %lu evictions",
+							_hits, _misses, _evictions);
+				}
+			}
+
+			touch(entry);
+			memcpy(out, entry->data + (first * bs), n * bs);
+
+			out += n * bs;
+			offset += n;
+			remaining -= n;
+		}
+
+		return count;
+	}
+
+	int write_blocks(const void *buffer, size_t offset, size_t count) override
+	{
+		BlockDevice *backing = resolve_backing();
+		if (!backing || !in_range(backing, offset, count)) return -1;
+
+		UniqueLock<Mutex> l(_mtx);
+
+		int rc = backing->write_blocks(buffer, offset, count);
+		if (rc <= 0) return rc;
+
+		// Bring any cached copies of the written blocks up to date.
+		size_t bs = backing->block_size();
+		size_t blocks_per_page = CACHE_PAGE_SIZE / bs;
+		const uint8_t *in = (const uint8_t *)buffer;
+		size_t remaining = count;
+
+		while (remaining > 0) {
+			uint64_t page = offset / blocks_per_page;
+			size_t first = offset % blocks_per_page;
+			size_t n = blocks_per_page - first;
+			if (n > remaining) n = remaining;
+
+			CacheEntry *entry = lookup(page);
+			if (entry) {
+				memcpy(entry->data + (first * bs), in, n * bs);
+			}
+
+			in += n * bs;
+			offset += n;
+			remaining -= n;
+		}
+
+		return rc;
+	}
+
+private:
+	BlockDevice *resolve_backing() const
+	{
+		return backing_device.resolve(*_dm);
+	}
+
+	/**
+	 * Allocates the staging area on the first miss, so that a cache that is never read
+	 * costs nothing.  The staging area receives multi-page reads from the backing device,
+	 * before they are split up into cache pages.  Called with the cache locked.
+	 * @return Returns TRUE if the staging area is available.
+	 */
+	bool ensure_staging()
+	{
+		if (_staging) return true;
+
+		PageDescriptor *staging = sys.mm().pgalloc().alloc_pages(READAHEAD_ORDER);
+		if (!staging) {
+			syslog.messagef(LogLevel::ERROR, "blockcache: unable to allocate the read-ahead buffer");
+			return false;
+		}
+
+		_staging = (uint8_t *)sys.mm().pgalloc().pgd_to_vpa(staging);
+		return true;
+	}
+
+	/**
+	 * Returns TRUE if a request lies entirely within the backing device.
+	 */
+	static bool in_range(BlockDevice *backing, size_t offset, size_t count)
+	{
+		size_t nr_blocks = backing->block_count();
+		return offset <= nr_blocks && count <= nr_blocks - offset;
+	}
+
+	static unsigned int hash(uint64_t page)
+	{
+		return (page ^ (page >> 8)) % NR_HASH_BUCKETS;
+	}
+
+	CacheEntry *lookup(uint64_t page)
+	{
+		for (CacheEntry *entry = _buckets[hash(page)]; entry; entry = entry->hash_next) {
+			if (entry->page == page) return entry;
+		}
+
+		return NULL;
+	}
+
+	/**
+	 * Moves an entry to the most recently used end of the LRU list.
+	 */
+	void touch(CacheEntry *entry)
+	{
+		if (_lru_head == entry) return;
+
+		lru_unlink(entry);
+
+		entry->lru_prev = NULL;
+		entry->lru_next = _lru_head;
+		if (_lru_head) _lru_head->lru_prev = entry;
+		_lru_head = entry;
+		if (!_lru_tail) _lru_tail = entry;
+	}
+
+	void lru_unlink(CacheEntry *entry)
+	{
+		if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+		if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+		if (_lru_head == entry) _lru_head = entry->lru_next;
+		if (_lru_tail == entry) _lru_tail = entry->lru_prev;
+
+		entry->lru_prev = NULL;
+		entry->lru_next = NULL;
+	}
+
+	void hash_unlink(CacheEntry *entry)
+	{
+		CacheEntry **link = &_buckets[hash(entry->page)];
+
+		while (*link != entry) {
+			link = &(*link)->hash_next;
+		}
+
+		*link = entry->hash_next;
+	}
+
+	/**
+	 * Returns an entry that is not in use: a new one while the cache is below its
+	 * limit, otherwise the least recently used one, evicted.
+	 */
+	CacheEntry *claim_entry()
+	{
+		if (_nr_entries < cache_page_limit) {
+			PageDescriptor *pgd = sys.mm().pgalloc().alloc_pages(0);
+
+			if (pgd) {
+				CacheEntry *entry = &_entries[_nr_entries++];
+
+				entry->pgd = pgd;
+				entry->data = (uint8_t *)sys.mm().pgalloc().pgd_to_vpa(pgd);
+				entry->lru_prev = NULL;
+				entry->lru_next = NULL;
+				return entry;
+			}
+		}
+
+		CacheEntry *victim = _lru_tail;
+		if (!victim) return NULL;
+
+		lru_unlink(victim);
+		hash_unlink(victim);
+		_evictions++;
+
+		return victim;
+	}
+
+	/**
+	 * Reads a page that missed from the backing device, along with the pages after it
+	 * if the reader appears to be going through the device sequentially.
+	 * @return Returns the entry for the requested page, or NULL on an I/O error, or if
+	 * the staging area could not be allocated.
+	 */
+	CacheEntry *fill(BlockDevice *backing, uint64_t page)
+	{
+		if (!ensure_staging()) return NULL;
+
+		size_t bs = backing->block_size();
+		size_t blocks_per_page = CACHE_PAGE_SIZE / bs;
+		uint64_t nr_pages_on_device = (backing->block_count() + blocks_per_page - 1) / blocks_per_page;
+
+		if (page == _next_sequential) {
+			_readahead *= 2;
+			if (_readahead > READAHEAD_MAX_PAGES) _readahead = READAHEAD_MAX_PAGES;
+		} else {
+			_readahead = READAHEAD_MIN_PAGES;
+		}
+
+		// Read up to the end of the device, or the next page that is already cached.
+		unsigned int nr_pages = 1;
+		while (nr_pages < _readahead && page + nr_pages < nr_pages_on_device && !lookup(page + nr_pages)) {
+			nr_pages++;
+		}
+
+		size_t first_block = page * blocks_per_page;
+		if (first_block >= backing->block_count()) return NULL;
+
+		size_t nr_blocks = nr_pages * blocks_per_page;
+		if (first_block + nr_blocks > backing->block_count()) {
+			nr_blocks = backing->block_count() - first_block;
+		}
+
+		uint64_t start = read_tsc();
+		int rc = backing->read_blocks(_staging, first_block, nr_blocks);
+		backing_read_trace.add(read_tsc() - start);
+
+		if (rc <= 0) return NULL;
+
+		_next_sequential = page + nr_pages;
+
+		// Claim all the entries before linking any of them in, so that filling one
+		// cannot evict another.
+		CacheEntry *entries[READAHEAD_MAX_PAGES];
+		for (unsigned int i = 0; i < nr_pages; i++) {
+			entries[i] = claim_entry();
+			if (!entries[i]) {
+				nr_pages = i;
+				break;
+			}
+		}
+
+		if (nr_pages == 0) return NULL;
+
+		// The last page of the device may only be partly backed by blocks, so only the
+		// blocks that were read are copied, and the rest of the page is zeroed.
+		size_t nr_bytes = nr_blocks * bs;
+
+		for (unsigned int i = 0; i < nr_pages; i++) {
+			CacheEntry *entry = entries[i];
+			size_t page_start = i * CACHE_PAGE_SIZE;
+			size_t page_bytes = nr_bytes - page_start < CACHE_PAGE_SIZE ? nr_bytes - page_start : CACHE_PAGE_SIZE;
+
+			entry->page = page + i;
+			memcpy(entry->data, _staging + page_start, page_bytes);
+			if (page_bytes < CACHE_PAGE_SIZE) {
+				memset(entry->data + page_bytes, 0, CACHE_PAGE_SIZE - page_bytes);
+			}
+
+			unsigned int bucket = hash(entry->page);
+			entry->hash_next = _buckets[bucket];
+			_buckets[bucket] = entry;
+
+			// Read-ahead pages go in at the cold end, so that a read-ahead that is never
+			// used does not push out pages that are.
+			if (i == 0 || !_lru_tail) {
+				touch(entry);
+			} else {
+				entry->lru_prev = _lru_tail;
+				entry->lru_next = NULL;
+				_lru_tail->lru_next = entry;
+				_lru_tail = entry;
+			}
+		}
+
+		return entries[0];
+	}
+
+	DeviceManager *_dm;
+	Mutex _mtx;
+
+	CacheEntry _entries[MAX_CACHE_PAGES];
+	unsigned int _nr_entries;
+
+	CacheEntry *_buckets[NR_HASH_BUCKETS];
+	CacheEntry *_lru_head, *_lru_tail;
+
+	uint8_t *_staging;
+	uint64_t _next_sequential;
+	unsigned int _readahead;
+
+	uint64_t _hits, _misses, _evictions;
+};
+
+const DeviceClass BlockCacheDevice::BlockCacheDeviceClass(BlockDevice::BlockDeviceClass, "blockcache");
+
+RegisterDevice(BlockCacheDevice);
@@ -0,0 +1,339 @@
+/*
+ * Block Request Queue
+ *
+ * The queue itself, and the blockqueue device, which puts a queue in front of
+ * another block device (ata0 unless blockqueue.device is given), so that
+ * concurrent readers of the rootfs have their requests sorted and merged.
+ * Boot with boot-device=blockqueue0 to use it.  The queue's worker thread and
+ * merge buffer are only set up when the device is first used.
+ */
+#include <infos/drivers/block/block-device.h>
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/kernel/process.h>
+#include <infos/kernel/sched.h>
+#include <infos/kernel/thread.h>
+#include <infos/mm/mm.h>
+#include <infos/mm/page-allocator.h>
+#include <infos/util/cmdline.h>
+#include <infos/util/lock.h>
+#include <infos/util/string.h>
+
+#include "backing-device.h"
+#include "block-queue.h"
+#include "thread-sleep.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::drivers::block;
+using namespace infos::mm;
+using namespace infos::util;
+
+// The merge buffer: 128KB
+#define MERGE_BUFFER_ORDER	5
+#define MERGE_BUFFER_SIZE	(0x1000 << MERGE_BUFFER_ORDER)
+
+BlockRequestQueue::BlockRequestQueue()
+	: _device(NULL), _worker(NULL), _worker_idle(false), _pending(NULL), _elevator(0),
+	_merge_buffer(NULL), _max_merge_blocks(1), _nr_dispatched(0), _nr_merged(0)
+{
+}
+
+bool BlockRequestQueue::start()
+{
+	PageDescriptor *pgd = sys.mm().pgalloc().alloc_pages(MERGE_BUFFER_ORDER);
+	if (!pgd) {
+		syslog.messagef(LogLevel::ERROR, "blockqueue: unable to allocate the merge buffer");
+		return false;
+	}
+
+	_merge_buffer = (uint8_t *)sys.mm().pgalloc().pgd_to_vpa(pgd);
+
+	_worker = sys.kernel_process().create_thread(ThreadPrivilege::Kernel, (Thread::thread_proc_t)worker_thread_proc, "blockqueue");
+	if (!_worker) {
+		syslog.messagef(LogLevel::ERROR, "blockqueue: unable to create the worker thread");
+		return false;
+	}
+
+	_worker->start((unsigned long)this);
+	return true;
+}
+
+void BlockRequestQueue::attach(BlockDevice& device)
+{
+	_device = &device;
+
+	_max_merge_blocks = MERGE_BUFFER_SIZE / device.block_size();
+	if (_max_merge_blocks == 0) _max_merge_blocks = 1;
+}
+
+void BlockRequestQueue::submit(BlockRequest& request)
+{
+	if (!_worker) {
+		// Without a worker, service the request in the caller's context.
+		request._done = false;
+		complete(&request, request.write ?
+				_device->write_blocks(request.buffer, request.offset, request.count) :
+				_device->read_blocks(request.buffer, request.offset, request.count));
+		return;
+	}
+
+	UniqueIRQLock l;
+
+	request._done = false;
+	request._waiter = NULL;
+
+	// Insert the request in LBA order, after any requests for the same block, so that
+	// those are serviced in submission order.
+	BlockRequest **link = &_pending;
+	while (*link && (*link)->offset <= request.offset) {
+		link = &(*link)->_next;
+	}
+
+	request._next = *link;
+	*link = &request;
+
+	if (_worker_idle) {
+		_worker_idle = false;
+		wake_thread(*_worker);
+	}
+}
+
+int BlockRequestQueue::wait(BlockRequest& request)
+{
+	while (true) {
+		UniqueIRQLock l;
+
+		if (request._done) break;
+
+		request._waiter = &Thread::current();
+		sleep_current();
+	}
+
+	return request.result;
+}
+
+BlockRequest *BlockRequestQueue::take_next(size_t& nr_blocks)
+{
+	if (!_pending) return NULL;
+
+	// Carry on upwards from where the last request ended, or wrap back to the start.
+	BlockRequest **link = &_pending;
+	while (*link && (*link)->offset < _elevator) {
+		link = &(*link)->_next;
+	}
+
+	if (!*link) link = &_pending;
+
+	BlockRequest *head = *link;
+	*link = head->_next;
+	head->_next = NULL;
+
+	nr_blocks = head->count;
+
+	// Merge in the requests that start where the chain ends, in the same direction.
+	BlockRequest *tail = head;
+	while (*link && (*link)->write == head->write && (*link)->offset == head->offset + nr_blocks &&
+			nr_blocks + (*link)->count <= _max_merge_blocks) {
+		BlockRequest *next = *link;
+
+		*link = next->_next;
+		next->_next = NULL;
+
+		tail->_next = next;
+		tail = next;
+		nr_blocks += next->count;
+		_nr_merged++;
+	}
+
+	return head;
+}
+
+void BlockRequestQueue::dispatch(BlockRequest *chain, size_t nr_blocks)
+{
+	size_t offset = chain->offset;
+	bool write = chain->write;
+	int rc;
+
+	_nr_dispatched++;
+	_elevator = offset + nr_blocks;
+
+	if (!chain->_next) {
+		// A lone request goes straight to (or from) its own buffer.
+		rc = write ?
+				_device->write_blocks(chain->buffer, offset, nr_blocks) :
+				_device->read_blocks(chain->buffer, offset, nr_blocks);
+
+		complete(chain, rc);
+		return;
+	}
+
+	size_t bs = _device->block_size();
+
+	if (write) {
+		for (BlockRequest *request = chain; request; request = request->_next) {
+			memcpy(_merge_buffer + ((request->offset - offset) * bs), request->buffer, request->count * bs);
+		}
+
+		rc = _device->write_blocks(_merge_buffer, offset, nr_blocks);
+	} else {
+		rc = _device->read_blocks(_merge_buffer, offset, nr_blocks);
+	}
+
+	while (chain) {
+		BlockRequest *next = chain->_next;
+
+		if (!write && rc > 0) {
+			memcpy(chain->buffer, _merge_buffer + ((chain->offset - offset) * bs), chain->count * bs);
+		}
+
+		complete(chain, rc > 0 ? (int)chain->count : rc);
+		chain = next;
+	}
+}
+
+void BlockRequestQueue::complete(BlockRequest *request, int result)
+{
+	UniqueIRQLock l;
+
+	request->result = result;
+	request->_next = NULL;
+	request->_done = true;
+
+	if (request->_waiter) {
+		wake_thread(*request->_waiter);
+	}
+}
+
+void BlockRequestQueue::worker_thread_proc(BlockRequestQueue *queue)
+{
+	queue->worker();
+}
+
+void BlockRequestQueue::worker()
+{
+	while (true) {
+		BlockRequest *chain;
+		size_t nr_blocks;
+
+		{
+			UniqueIRQLock l;
+
+			chain = take_next(nr_blocks);
+			if (!chain) {
+				_worker_idle = true;
+				sleep_current();
+				continue;
+			}
+		}
+
+		dispatch(chain, nr_blocks);
+	}
+}
+
+static BackingDevice backing_device("blockqueue", "ata0");
+
+RegisterCmdLineArgument(BlockQueueBacking, "blockqueue.device") {
+	backing_device.set_name(value);
+}
+
+/**
+ * A block device that sends its reads and writes through a request queue.  Each
+ * caller still waits for its own request, but requests from different threads are
+ * sorted and merged while they wait.
+ */
+class BlockQueueDevice : public BlockDevice
+{
+public:
+	static const DeviceClass BlockQueueDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return BlockQueueDeviceClass;
+	}
+
+	BlockQueueDevice() : _dm(NULL), _started(false) { }
+
+	bool init(DeviceManager& dm) override
+	{
+		_dm = &dm;
+		return true;
+	}
+
+	/**
+	 * Returns the queue, for callers that want to submit requests asynchronously.
+	 */
+	BlockRequestQueue *queue()
+	{
+		return resolve_backing() ? &_queue : NULL;
+	}
+
+	size_t block_size() const override
+	{
+		BlockDevice *backing = resolve_backing();
+		return backing ? backing->block_size() : 0;
+	}
+
+	size_t block_count() const override
+	{
+		BlockDevice *backing = resolve_backing();
+		return backing ? backing->block_count() : 0;
+	}
+
+	int read_blocks(void *buffer, size_t offset, size_t count) override
+	{
+		if (!resolve_backing()) return -1;
+
+		BlockRequest request;
+		request.offset = offset;
+		request.count = count;
+		request.buffer = buffer;
+
+		return _queue.execute(request);
+	}
+
+	int write_blocks(const void *buffer, size_t offset, size_t count) override
+	{
+		if (!resolve_backing()) return -1;
+
+		BlockRequest request;
+		request.write = true;
+		request.offset = offset;
+		request.count = count;
+		request.buffer = (void *)buffer;
+
+		return _queue.execute(request);
+	}
+
+private:
+	/**
+	 * Returns the backing device, looking it up, and attaching and starting the queue,
+	 * the first time it is needed.
+	 */
+	BlockDevice *resolve_backing() const
+	{
+		BlockDevice *backing = backing_device.resolve(*_dm);
+		if (!backing) return NULL;
+
+		if (!_started) {
+			UniqueLock<Mutex> l(_start_mtx);
+
+			if (!_started) {
+				_queue.attach(*backing);
+				_queue.start();
+				_started = true;
+			}
+		}
+
+		return backing;
+	}
+
+	DeviceManager *_dm;
+	mutable BlockRequestQueue _queue;
+	mutable volatile bool _started;
+	mutable Mutex _start_mtx;
+};
+
+const DeviceClass BlockQueueDevice::BlockQueueDeviceClass(BlockDevice::BlockDeviceClass, "blockqueue");
+
+RegisterDevice(BlockQueueDevice);
@@ -0,0 +1,121 @@
+/*
+ * Block Request Queue
+ *
+ * An asynchronous request queue for a block device.  Callers submit reads and
+ * writes, and carry on with other work; a kernel thread services the queue in
+ * ascending LBA order (wrapping around at the end, like a one-way elevator),
+ * merges runs of adjacent requests in the same direction into one device
+ * command, and wakes each submitter as its request completes.  A file system
+ * can submit all the reads it needs for a file at once, and then wait for
+ * them together.
+ *
+ * Submitters and the worker sleep while they wait, rather than spinning.  The
+ * block device interface is synchronous, so the worker waits for each command
+ * inside the device driver; with atadma0 behind the queue, the worker sleeps
+ * there until the disk's interrupt, and the CPU is free in the meantime.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <infos/drivers/block/block-device.h>
+#include <infos/kernel/thread.h>
+
+/**
+ * One read or write, from submission to completion.  The request belongs to the
+ * submitter, and must stay alive until it has completed.
+ */
+struct BlockRequest
+{
+	BlockRequest() : write(false), offset(0), count(0), buffer(NULL), result(0),
+		_done(false), _waiter(NULL), _next(NULL) { }
+
+	bool write;			// TRUE to write the buffer to the device, FALSE to read into it
+	size_t offset;		// The first block
+	size_t count;		// The number of blocks
+	void *buffer;
+
+	int result;			// The device's result, once the request has completed
+
+	/**
+	 * Returns TRUE once the request has completed.
+	 */
+	bool done() const { return _done; }
+
+private:
+	friend class BlockRequestQueue;
+
+	volatile bool _done;
+	infos::kernel::Thread *_waiter;		// The thread waiting for this request, if any
+	BlockRequest *_next;				// The next request in LBA order
+};
+
+class BlockRequestQueue
+{
+public:
+	BlockRequestQueue();
+
+	/**
+	 * Allocates the merge buffer, and starts the worker thread.  Until the queue is
+	 * started (or if it fails to start), requests are serviced synchronously, in the
+	 * submitter's context.
+	 * @return Returns TRUE if the queue started.
+	 */
+	bool start();
+
+	/**
+	 * Sets the device the queue issues requests to.  Must be called before the first
+	 * submission.
+	 */
+	void attach(infos::drivers::block::BlockDevice& device);
+
+	/**
+	 * Queues a request, and returns without waiting for it.
+	 * @param request The request, which must not already be queued.
+	 */
+	void submit(BlockRequest& request);
+
+	/**
+	 * Sleeps until a request has completed.
+	 * @return Returns the request's result.
+	 */
+	int wait(BlockRequest& request);
+
+	/**
+	 * Submits a request and waits for it.
+	 * @return Returns the request's result.
+	 */
+	int execute(BlockRequest& request)
+	{
+		submit(request);
+		return wait(request);
+	}
+
+	uint64_t nr_dispatched() const { return _nr_dispatched; }
+	uint64_t nr_merged() const { return _nr_merged; }
+
+private:
+	static void worker_thread_proc(BlockRequestQueue *queue);
+	void worker();
+
+	/**
+	 * Removes the next request to service, in elevator order, along with the
+	 * requests that follow on from it and can be merged with it.
+	 * @return Returns the chain of requests, or NULL if the queue is empty.
+	 */
+	BlockRequest *take_next(size_t& nr_blocks);
+
+	void dispatch(BlockRequest *chain, size_t nr_blocks);
+	void complete(BlockRequest *request, int result);
+
+	infos::drivers::block::BlockDevice *_device;
+	infos::kernel::Thread *_worker;
+	bool _worker_idle;
+
+	BlockRequest *_pending;		// Pending requests, in ascending LBA order
+	size_t _elevator;			// The block after the last one dispatched
+
+	uint8_t *_merge_buffer;
+	size_t _max_merge_blocks;	// The most blocks that fit in the merge buffer
+
+	uint64_t _nr_dispatched, _nr_merged;
+};
@@ -0,0 +1,192 @@
+/*
+ * Boot-phase Profiling
+ */
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/process.h>
+#include <infos/kernel/thread.h>
+#include <infos/util/lock.h>
+
+#include "boot-trace.h"
+#include "snapshot-device.h"
+#include "thread-sleep.h"
+#include "wallclock.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::util;
+
+#define MAX_BOOT_TRACE_EVENTS	128
+#define MAX_BOOT_TRACE_COUNTERS	16
+
+// How long the reporter waits for the wall clock to be calibrated, and how often it checks
+#define REPORT_CALIBRATION_TIMEOUT_NS	5000000000ull
+#define REPORT_POLL_INTERVAL_NS			100000000ull
+
+struct BootTraceEvent
+{
+	const char *name;
+	uint64_t start_tsc;
+	uint64_t end_tsc;		// Equal to start_tsc for instantaneous events
+};
+
+static BootTraceEvent events[MAX_BOOT_TRACE_EVENTS];
+static unsigned int nr_events;
+
+static BootTraceCounter *counters[MAX_BOOT_TRACE_COUNTERS];
+static unsigned int nr_counters;
+
+static void record(const char *name, uint64_t start_tsc, uint64_t end_tsc)
+{
+	UniqueIRQLock l;
+
+	if (nr_events >= MAX_BOOT_TRACE_EVENTS) return;
+
+	events[nr_events].name = name;
+	events[nr_events].start_tsc = start_tsc;
+	events[nr_events].end_tsc = end_tsc;
+	nr_events++;
+}
+
+void boot_trace(const char *name)
+{
+	uint64_t now = read_tsc();
+	record(name, now, now);
+}
+
+void boot_trace_span(const char *name, uint64_t start_tsc)
+{
+	record(name, start_tsc, read_tsc());
+}
+
+BootTraceCounter::BootTraceCounter(const char *name) : _name(name), _count(0), _cycles(0)
+{
+	if (nr_counters < MAX_BOOT_TRACE_COUNTERS) {
+		counters[nr_counters++] = this;
+	}
+}
+
+/**
+ * Renders the boot timeline.  The timeline is rendered once, by a kernel thread as soon
+ * as the wall clock has been calibrated (so that times are in microseconds), or by the
+ * first read if that comes sooner, and written to the system log and the debug console
+ * at the same time.
+ */
+class BootTraceDevice : public SnapshotDevice<8192>
+{
+public:
+	static const DeviceClass BootTraceDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return BootTraceDeviceClass;
+	}
+
+	BootTraceDevice() : _rendered(false) { }
+
+	bool init(DeviceManager& dm) override
+	{
+		Thread *reporter = sys.kernel_process().create_thread(ThreadPrivilege::Kernel,
+				(Thread::thread_proc_t)reporter_thread_proc, "boot-trace");
+		if (!reporter) {
+			syslog.messagef(LogLevel::WARNING, "boot-trace: unable to create the reporter thread");
+			return true;
+		}
+
+		reporter->start((unsigned long)this);
+		return true;
+	}
+
+private:
+	/**
+	 * Waits (for a bounded time) for the wall clock to be calibrated, then renders the
+	 * timeline, so that it reaches the debug console whether or not anything reads the
+	 * device.
+	 */
+	static void reporter_thread_proc(BootTraceDevice *device)
+	{
+		uint64_t give_up = sys.runtime().count() + REPORT_CALIBRATION_TIMEOUT_NS;
+
+		while (sleep_clock_running()) {
+			UniqueIRQLock l;
+
+			if (wallclock.calibrated() || sys.runtime().count() >= give_up) break;
+			sleep_current(sys.runtime().count() + REPORT_POLL_INTERVAL_NS);
+		}
+
+		device->snapshot();
+	}
+
+	/**
+	 * Converts a number of TSC cycles into microseconds, or leaves it in cycles if the TSC
+	 * has not been calibrated.  The kernel is linked without libgcc, so there is no
+	 * 128-bit division; whole seconds and the remainder are converted separately.
+	 */
+	static uint64_t to_us(uint64_t cycles)
+	{
+		uint64_t hz = wallclock.tsc_hz();
+		if (!hz) return cycles;
+
+		return (cycles / hz) * 1000000 + ((cycles % hz) * 1000000) / hz;
+	}
+
+	void snapshot() override
+	{
+		UniqueLock<Mutex> l(_render_mtx);
+
+		if (_rendered) return;
+
+		_rendered = true;
+		boot_trace("boot-trace.report");
+
+		BootTraceEvent *sorted = _sorted;
+		unsigned int n;
+
+		{
+			UniqueIRQLock l;
+
+			n = nr_events;
+			memcpy(sorted, events, n * sizeof(sorted[0]));
+		}
+
+		// Events are recorded when they end, so order them by when they started.
+		for (unsigned int i = 1; i < n; i++) {
+			BootTraceEvent e = sorted[i];
+			unsigned int j = i;
+
+			while (j > 0 && sorted[j - 1].start_tsc > e.start_tsc) {
+				sorted[j] = sorted[j - 1];
+				j--;
+			}
+
+			sorted[j] = e;
+		}
+
+		const char *unit = wallclock.tsc_hz() ? "us" : "cycles";
+		uint64_t origin = n ? sorted[0].start_tsc : 0;
+
+		report_line("boot-trace", "timeline (%u events, times in %s since the first event)", n, unit);
+
+		for (unsigned int i = 0; i < n; i++) {
+			uint64_t at = to_us(sorted[i].start_tsc - origin);
+
+			if (sorted[i].end_tsc == sorted[i].start_tsc) {
+				report_line("boot-trace", "  +%10lu               %s", at, sorted[i].name);
+			} else {
+				report_line("boot-trace", "  +%10lu  [%10lu]  %s", at, to_us(sorted[i].end_tsc - sorted[i].start_tsc), sorted[i].name);
+			}
+		}
+
+		for (unsigned int i = 0; i < nr_counters; i++) {
+			report_line("boot-trace", "  %s: %lu calls, %lu %s", counters[i]->name(), counters[i]->count(),
+					to_us(counters[i]->cycles()), unit);
+		}
+	}
+
+	Mutex _render_mtx;
+	bool _rendered;
+	BootTraceEvent _sorted[MAX_BOOT_TRACE_EVENTS];
+};
+
+const DeviceClass BootTraceDevice::BootTraceDeviceClass(CharacterDevice::CharacterDeviceClass, "boot-trace");
+
+RegisterDevice(BootTraceDevice);
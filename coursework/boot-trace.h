@@ -0,0 +1,65 @@
+/*
+ * Boot-phase Profiling
+ *
+ * TSC-stamped trace points for subsystem initialisation and module
+ * registration.  Recording a trace point only stores a timestamp; the
+ * timeline is formatted once the wall clock has been calibrated, shortly
+ * after boot, and written to the system log and to QEMU's debug console.  It
+ * can be read back from the boot-trace device.
+ */
+#pragma once
+
+#include <infos/define.h>
+
+#include "tsc.h"
+
+/**
+ * Records an instantaneous boot event.
+ * @param name The name of the event.  The string must remain valid forever.
+ */
+extern void boot_trace(const char *name);
+
+/**
+ * Records a boot phase that spans from the given start time until now.
+ * @param name The name of the phase.  The string must remain valid forever.
+ * @param start_tsc The TSC value at the start of the phase.
+ */
+extern void boot_trace_span(const char *name, uint64_t start_tsc);
+
+/**
+ * Records the boot phase covered by the enclosing scope.
+ */
+class BootTraceScope
+{
+public:
+	BootTraceScope(const char *name) : _name(name), _start(read_tsc()) { }
+	~BootTraceScope() { boot_trace_span(_name, _start); }
+
+private:
+	const char *_name;
+	uint64_t _start;
+};
+
+/**
+ * Accumulates the number of calls to, and total time spent in, an operation that
+ * runs many times during boot (e.g. reserving a page).
+ */
+class BootTraceCounter
+{
+public:
+	BootTraceCounter(const char *name);
+
+	void add(uint64_t cycles)
+	{
+		_count++;
+		_cycles += cycles;
+	}
+
+	const char *name() const { return _name; }
+	uint64_t count() const { return _count; }
+	uint64_t cycles() const { return _cycles; }
+
+private:
+	const char *_name;
+	uint64_t _count, _cycles;
+};
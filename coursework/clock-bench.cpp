@@ -0,0 +1,324 @@
+/*
+ * Clock-source Benchmark
+ *
+ * When the kernel is booted with clockbench=1, measures the read cost and
+ * resolution of each clock source (TSC, PIT, LAPIC timer, CMOS RTC, the
+ * kernel's runtime, and the TSC-based wall clock), cross-calibrates the
+ * counters against the PIT and the RTC, and reports whether the TSC, which
+ * the wall clock extrapolates from, is invariant.  The results are written to
+ * the system log and to QEMU's debug console, and can be read back from the
+ * clock-bench device.
+ */
+#include <infos/kernel/kernel.h>
+#include <infos/mm/mm.h>
+#include <infos/util/cmdline.h>
+#include <infos/util/lock.h>
+#include <arch/x86/pio.h>
+
+#include "boot-trace.h"
+#include "snapshot-device.h"
+#include "tsc.h"
+#include "wallclock.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::mm;
+using namespace infos::util;
+using namespace infos::arch::x86;
+
+// The number of back-to-back reads used to measure the read cost of a source
+#define READ_ITERATIONS		1000
+
+// The frequency of the PIT input clock, in Hz
+#define PIT_HZ				1193182
+
+// The length of the PIT calibration window: 50ms
+#define PIT_WINDOW_TICKS	(PIT_HZ / 20)
+
+#define LAPIC_BASE_MSR		0x1B
+#define LAPIC_TIMER_INITIAL	0x380
+#define LAPIC_TIMER_CURRENT	0x390
+
+static bool clockbench_enabled;
+
+RegisterCmdLineArgument(ClockBench, "clockbench") {
+	if (strncmp(value, "1", 1) == 0) {
+		clockbench_enabled = true;
+	}
+}
+
+/**
+ * The measurements taken for a single clock source.
+ */
+struct ClockSourceResult
+{
+	const char *name;
+	bool available;
+	uint64_t read_cycles;		// TSC cycles per read
+	uint64_t resolution_ns;		// Smallest observable step
+	uint64_t hz;				// Counting frequency, for counters
+};
+
+class ClockBenchDevice : public SnapshotDevice<2048>
+{
+public:
+	static const DeviceClass ClockBenchDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return ClockBenchDeviceClass;
+	}
+
+	bool init(DeviceManager& dm) override
+	{
+		if (clockbench_enabled) {
+			BootTraceScope trace("clock-bench.run");
+			run();
+		}
+		return true;
+	}
+
+private:
+	static inline uint64_t rdmsr(uint32_t msr)
+	{
+		uint32_t lo, hi;
+		asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+		return ((uint64_t)hi << 32) | lo;
+	}
+
+	/**
+	 * Returns TRUE if the CPU advertises an invariant TSC, i.e. one that ticks at a constant
+	 * rate regardless of power state.
+	 */
+	static bool tsc_invariant()
+	{
+		uint32_t eax, ebx, ecx, edx;
+
+		asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000000));
+		if (eax < 0x80000007) return false;
+
+		asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0x80000007));
+		return edx & (1 << 8);
+	}
+
+	/**
+	 * Latches and reads the counter of PIT channel 0.
+	 */
+	static uint16_t pit_read()
+	{
+		__outb(0x43, 0x00);
+		uint8_t lo = __inb(0x40);
+		uint8_t hi = __inb(0x40);
+		return ((uint16_t)hi << 8) | lo;
+	}
+
+	/**
+	 * Reads a LAPIC timer register.
+	 */
+	static uint32_t lapic_read(unsigned int reg = LAPIC_TIMER_CURRENT)
+	{
+		phys_addr_t base = rdmsr(LAPIC_BASE_MSR) & ~0xFFFull;
+		return *(volatile uint32_t *)pa_to_vpa(base + reg);
+	}
+
+	/**
+	 * Reads a CMOS register.  Interrupts are disabled so that the RTC interrupt handler
+	 * cannot change the selected register in between.
+	 */
+	static uint8_t cmos_read(uint8_t offset)
+	{
+		UniqueIRQLock l;
+
+		__outb(0x70, offset);
+		return __inb(0x71);
+	}
+
+	/**
+	 * Runs PIT channel 2 as a one-shot for the calibration window, and returns the number
+	 * of TSC cycles and LAPIC timer counts that elapsed during it.  The LAPIC timer is
+	 * usually periodic (it drives the scheduler tick), with a period shorter than the
+	 * window, so its count is sampled throughout the window, and every reload to the
+	 * initial count is accounted for.  The period is far longer than one sample, so at
+	 * most one reload happens between two samples.
+	 */
+	static void pit_window(uint64_t& tsc_cycles, uint64_t& lapic_counts)
+	{
+		UniqueIRQLock l;
+
+		// Gate channel 2 on, with the speaker output disabled.
+		__outb(0x61, (__inb(0x61) & ~0x02) | 0x01);
+
+		// Channel 2, lo/hi access, mode 0 (interrupt on terminal count), binary.
+		__outb(0x43, 0xB0);
+		__outb(0x42, PIT_WINDOW_TICKS & 0xFF);
+		__outb(0x42, PIT_WINDOW_TICKS >> 8);
+
+		uint32_t lapic_initial = lapic_read(LAPIC_TIMER_INITIAL);
+		uint32_t lapic_last = lapic_read();
+		uint64_t tsc_start = read_tsc();
+
+		lapic_counts = 0;
+
+		// Wait for the channel 2 output to go high.
+		bool done;
+		do {
+			done = __inb(0x61) & 0x20;
+
+			uint32_t lapic_now = lapic_read();
+			if (lapic_now <= lapic_last) {
+				lapic_counts += lapic_last - lapic_now;
+			} else {
+				// The timer reached zero, and reloaded from the initial count.
+				lapic_counts += lapic_last + (lapic_initial - lapic_now);
+			}
+			lapic_last = lapic_now;
+		} while (!done);
+
+		tsc_cycles = read_tsc() - tsc_start;
+	}
+
+	/**
+	 * Waits for an RTC update cycle to end, i.e. for the next second boundary.
+	 */
+	static void rtc_wait_second()
+	{
+		while (!(cmos_read(0x0A) & 0x80));
+		while (cmos_read(0x0A) & 0x80);
+	}
+
+	/**
+	 * Measures the read cost of a source, by timing back-to-back reads with the TSC.
+	 */
+	template<typename F>
+	static uint64_t read_cost(F read)
+	{
+		volatile uint64_t sink;
+
+		uint64_t start = read_tsc();
+		for (unsigned int i = 0; i < READ_ITERATIONS; i++) {
+			sink = read();
+		}
+		return (read_tsc() - start) / READ_ITERATIONS;
+	}
+
+	/**
+	 * Measures the smallest non-zero step between consecutive reads of a source, in the
+	 * source's own units, giving up after a bounded number of reads.
+	 */
+	template<typename F>
+	static uint64_t min_step(F read)
+	{
+		uint64_t best = 0;
+		uint64_t last = read();
+
+		for (unsigned int i = 0; i < READ_ITERATIONS * 100; i++) {
+			uint64_t now = read();
+			uint64_t step = now > last ? now - last : last - now;
+
+			if (step && (!best || step < best)) best = step;
+			last = now;
+		}
+
+		return best;
+	}
+
+	void report(const ClockSourceResult& r, uint64_t tsc_hz)
+	{
+		if (!r.available) {
+			report_line("clockbench", "%-10s unavailable", r.name);
+			return;
+		}
+
+		report_line("clockbench", "%-10s read=%lu cycles (%lu ns) resolution=%lu ns freq=%lu Hz", r.name,
+				r.read_cycles, r.read_cycles * 1000000000ull / tsc_hz, r.resolution_ns, r.hz);
+	}
+
+	void run()
+	{
+		report_line("clockbench", "measuring clock sources");
+
+		// Cross-calibrate the TSC and LAPIC timer against the PIT.
+		uint64_t tsc_cycles, lapic_counts;
+		pit_window(tsc_cycles, lapic_counts);
+
+		uint64_t tsc_hz_pit = tsc_cycles * PIT_HZ / PIT_WINDOW_TICKS;
+		uint64_t lapic_hz = lapic_counts * PIT_HZ / PIT_WINDOW_TICKS;
+
+		// ... and the TSC against the RTC, over one second.
+		rtc_wait_second();
+		uint64_t tsc_start = read_tsc();
+		uint64_t runtime_start = sys.runtime().count();
+		rtc_wait_second();
+		uint64_t tsc_hz_rtc = read_tsc() - tsc_start;
+		uint64_t runtime_second = sys.runtime().count() - runtime_start;
+
+		int64_t tsc_drift_ppm = ((int64_t)tsc_hz_pit - (int64_t)tsc_hz_rtc) * 1000000 / (int64_t)tsc_hz_rtc;
+		int64_t runtime_drift_ppm = ((int64_t)runtime_second - 1000000000) / 1000;
+
+		report_line("clockbench", "tsc: %lu Hz against the pit, %lu Hz against the rtc (drift %ld ppm), invariant=%u",
+				tsc_hz_pit, tsc_hz_rtc, tsc_drift_ppm, tsc_invariant());
+		report_line("clockbench", "runtime: %lu ns per rtc second (drift %ld ppm)", runtime_second, runtime_drift_ppm);
+
+		uint64_t tsc_hz = tsc_hz_rtc;
+		ClockSourceResult results[6];
+
+		results[0].name = "tsc";
+		results[0].available = true;
+		results[0].read_cycles = read_cost([] { return read_tsc(); });
+		results[0].resolution_ns = min_step([] { return read_tsc(); }) * 1000000000ull / tsc_hz;
+		results[0].hz = tsc_hz;
+
+		results[1].name = "pit";
+		results[1].available = min_step([] { return (uint64_t)pit_read(); }) != 0;
+		results[1].read_cycles = read_cost([] { return pit_read(); });
+		results[1].resolution_ns = min_step([] { return (uint64_t)pit_read(); }) * 1000000000ull / PIT_HZ;
+		results[1].hz = PIT_HZ;
+
+		results[2].name = "lapic";
+		results[2].available = lapic_hz != 0;
+		results[2].read_cycles = read_cost([] { return lapic_read(); });
+		results[2].resolution_ns = lapic_hz ? min_step([] { return (uint64_t)lapic_read(); }) * 1000000000ull / lapic_hz : 0;
+		results[2].hz = lapic_hz;
+
+		results[3].name = "cmos-rtc";
+		results[3].available = true;
+		results[3].read_cycles = read_cost([] {
+			return cmos_read(0x00) + cmos_read(0x02) + cmos_read(0x04) +
+				cmos_read(0x07) + cmos_read(0x08) + cmos_read(0x09);
+		});
+		results[3].resolution_ns = 1000000000ull;
+		results[3].hz = 1;
+
+		results[4].name = "runtime";
+		results[4].available = true;
+		results[4].read_cycles = read_cost([] { return sys.runtime().count(); });
+		results[4].resolution_ns = min_step([] { return sys.runtime().count(); });
+		results[4].hz = 1000000000ull;
+
+		// Calibrate the wall clock from the measurement, so the last source can be measured.
+		wallclock.calibrate(tsc_hz, read_tsc());
+
+		results[5].name = "wallclock";
+		results[5].available = true;
+		results[5].read_cycles = read_cost([] { return wallclock.monotonic_ns(); });
+		results[5].resolution_ns = min_step([] { return wallclock.monotonic_ns(); });
+		results[5].hz = 1000000000ull;
+
+		for (unsigned int i = 0; i < ARRAY_SIZE(results); i++) {
+			report(results[i], tsc_hz);
+		}
+
+		// The wall clock always extrapolates from the TSC (see wallclock.h), so report how
+		// suitable that is, rather than choosing a source it would not use.
+		if (tsc_invariant()) {
+			report_line("clockbench", "wall clock: tsc, which is invariant");
+		} else {
+			report_line("clockbench", "wall clock: tsc, which is not invariant, so the wall clock may drift with "
+					"power state between its periodic resynchronisations with the rtc");
+		}
+	}
+};
+
+const DeviceClass ClockBenchDevice::ClockBenchDeviceClass(CharacterDevice::CharacterDeviceClass, "clock-bench");
+
+RegisterDevice(ClockBenchDevice);
@@ -7,14 +7,44 @@
  * STUDENT NUMBER: s1768094
  */
 #include <infos/drivers/timer/rtc.h>
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/irq.h>
+#include <infos/kernel/log.h>
 #include <infos/util/lock.h>
 #include <arch/x86/pio.h>
+#include <arch/x86/x86-arch.h>
 
+#include "boot-trace.h"
+#include "log-ring.h"
+#include "timer-wheel.h"
+#include "tsc.h"
+#include "wallclock.h"
+
+using namespace infos::kernel;
 using namespace infos::drivers;
 using namespace infos::drivers::timer;
 using namespace infos::util;
 using namespace infos::arch::x86;
 
+// The legacy IRQ line of the CMOS RTC
+#define RTC_IRQ		8
+
+// Status register A: update in progress, and the periodic interrupt rate (32768 >> (rate - 1) Hz)
+#define RTC_REG_A_UIP	0x80
+#define RTC_REG_A_RATE	0x0F
+#define RTC_RATE_1024HZ	0x06
+// Status register B: periodic and update-ended interrupt enables, 24-hour mode, binary mode
+#define RTC_REG_B_PIE	0x40
+#define RTC_REG_B_UIE	0x10
+#define RTC_REG_B_24H	0x02
+#define RTC_REG_B_BIN	0x04
+// Status register C: periodic and update-ended interrupt flags
+#define RTC_REG_C_PF	0x40
+#define RTC_REG_C_UF	0x10
+
+// The number of update-ended interrupts between resynchronisations of the wall clock
+#define RTC_RESYNC_INTERVAL	64
+
 
 class CMOSRTC : public RTC {
 public:
@@ -25,6 +55,47 @@ public:
         return CMOSRTCDeviceClass;
     }
 
+    CMOSRTC() : _cache_valid(false), _seconds(0)
+    {
+        boot_trace("register-device cmos-rtc");
+    }
+
+    /**
+     * Initialises the RTC.  Reads the time once to seed the wall clock, and registers a
+     * handler for the update-ended interrupt, which calibrates the wall clock and keeps a
+     * cached copy of the time, so that reads never have to touch the chip.  The periodic
+     * interrupt is also enabled, at 1024Hz, to drive the kernel's sleep wheel (see
+     * timer-wheel.h) independently of the scheduler.  If the IRQ cannot be obtained, reads
+     * fall back to reading the chip directly, and timed sleeps are unavailable.
+     */
+    bool init(DeviceManager& dm) override
+    {
+        BootTraceScope trace("cmos-rtc.init");
+
+        RTCTimePoint tp;
+        read_CMOS_consistent(tp);
+
+        UniqueIRQLock l;
+
+        convert_format(tp);
+        wallclock.synchronise(tp, read_tsc());
+
+        IRQ *irq = infos::arch::x86::sys.irq_manager().request_physical_irq(RTC_IRQ, rtc_irq_handler, this);
+        if (!irq) {
+            syslog.messagef(LogLevel::WARNING, "cmos-rtc: unable to request irq %d, reads will poll the chip", RTC_IRQ);
+            return true;
+        }
+
+        // Enable the update-ended and periodic interrupts, and clear anything already pending.
+        set_register(0x0A, (get_register(0x0A) & ~RTC_REG_A_RATE) | RTC_RATE_1024HZ);
+        set_register(0x0B, get_register(0x0B) | RTC_REG_B_UIE | RTC_REG_B_PIE);
+        get_register(0x0C);
+
+        start_sleep_clock();
+
+        return true;
+    }
+
     /**
      * Convert binary coded decimal to binary number
      * @param BCD Binary coded decial integer number(8bits)
@@ -44,11 +115,13 @@ public:
     }
 
     /**
-     * Wait for an update cycle to begin and then wait for it being finished
+     * Set the value of CMOS memory at the given offset
+     * @param offset Offset of the CMOS memory location intended to write
+     * @param value The byte to write
      */
-    void update_in_process() {
-        while((get_register(0xA) & 0x80) == 0);
-        while (get_register(0xA) & 0x80);
+    void set_register(uint8_t offset, uint8_t value) {
+        __outb(0x70, offset);
+        __outb(0x71, value);
     }
 
     /**
@@ -63,6 +136,41 @@ public:
         tp.seconds = get_register(0x00);
     }
 
+    /**
+     * Read data from CMOS memory, unless an update cycle is in progress.  Interrupts are
+     * only disabled for the duration of the register accesses.
+     * @return Returns true if the registers were read, or false if an update was in progress.
+     */
+    bool try_read_CMOS(RTCTimePoint& tp) {
+        UniqueIRQLock l;
+
+        if (get_register(0x0A) & RTC_REG_A_UIP) return false;
+
+        read_CMOS(tp);
+        return true;
+    }
+
+    /**
+     * Read a consistent set of values from CMOS memory without waiting for an update cycle:
+     * read the registers until two consecutive reads agree, so that an update that happened
+     * part-way through a read is never observed.
+     */
+    void read_CMOS_consistent(RTCTimePoint& tp) {
+        RTCTimePoint last;
+
+        while (!try_read_CMOS(tp));
+
+        do {
+            last = tp;
+            while (!try_read_CMOS(tp));
+        } while (!same_timepoint(last, tp));
+    }
+
+    static bool same_timepoint(const RTCTimePoint& a, const RTCTimePoint& b) {
+        return a.seconds == b.seconds && a.minutes == b.minutes && a.hours == b.hours &&
+            a.day_of_month == b.day_of_month && a.month == b.month && a.year == b.year;
+    }
+
     /**
      * Convert time in binary coded decimal into binary 
      */
@@ -76,6 +184,27 @@ public:
         BCD_to_binary(tp.year);
     }
 
+    /**
+     * Convert the raw register values into binary, 24 hour format, according to the
+     * format given in status register B
+     */
+    void convert_format(RTCTimePoint& tp) {
+        uint8_t reg_b = get_register(0x0B);
+        bool is_binary = reg_b & RTC_REG_B_BIN;
+        bool is_24 = reg_b & RTC_REG_B_24H;
+
+        // Convert the value of time into binary if it is in binary coded decimal
+        if (!is_binary) {
+            BCD_time_to_binary_time(tp);
+        }
+
+        // Convert the value of hour into 24 hour format if it is in 12 hour format
+        // i.e. 12am is hour 0, and 12 hours are added if the hour is pm (0x80 bit is set)
+        if (!is_24) {
+            tp.hours = (tp.hours & 0x7F) % 12 + 12 * ((tp.hours & 0x80) >> 7);
+        }
+    }
+
     /**
      * Interrogates the RTC to read the current date & time.
      * @param tp Populates the tp structure with the current data & time, as
@@ -83,32 +212,73 @@ public:
      */
     void read_timepoint(RTCTimePoint& tp) override
     {
-        // Diabled interrupt before access RTC
+        // Once the TSC has been calibrated, the time is computed without any port I/O
+        if (wallclock.calibrated()) {
+            wallclock.read_timepoint(tp);
+            return;
+        }
+
+        // Use the copy maintained by the update-ended interrupt, if there is one
+        {
+            UniqueIRQLock l;
+
+            if (_cache_valid) {
+                tp = _cache;
+                return;
+            }
+        }
+
+        // Otherwise, read the chip, without waiting for an update cycle to begin
+        read_CMOS_consistent(tp);
+
         UniqueIRQLock l;
+        convert_format(tp);
+    }
 
-        // Wait for the chip to complete a full RTC update cycle
-        update_in_process();
+private:
+    /**
+     * Handles the RTC interrupt.  The periodic interrupt advances the sleep wheel.  The
+     * update-ended interrupt arrives exactly on each second boundary, and is used to
+     * calibrate the wall clock.  The chip has just finished updating, so the time
+     * registers are stable for almost a second.  They are only copied into the cache
+     * (and the wall clock resynchronised) until the wall clock is calibrated, and then
+     * once every resync interval.
+     */
+    static void rtc_irq_handler(const IRQ *irq, void *priv)
+    {
+        uint64_t tsc = read_tsc();
+        CMOSRTC *rtc = (CMOSRTC *)priv;
 
-        // Access the CMOS memory to read the value of RTC clock 
-        read_CMOS(tp);
-        
-        // Read the status register B to determine if the format of the value is BCD or binary
-        uint8_t reg_b = get_register(0x0B);
-        bool is_binary = reg_b & 0x04;
-        bool is_24 = reg_b & 0x02;
+        // Reading status register C acknowledges the interrupt, and reports which of the
+        // enabled interrupts are due.
+        uint8_t reg_c = rtc->get_register(0x0C);
 
-        // Convert the value of time into binary if it is in binary coded decimal
-		if (!is_binary) {
-			BCD_time_to_binary_time(tp);
-		}
+        if (reg_c & RTC_REG_C_PF) {
+            uint64_t now = infos::kernel::sys.runtime().count();
+
+            advance_sleepers(now);
+            log_ring_tick(now);
+        }
+
+        if (!(reg_c & RTC_REG_C_UF)) return;
+
+        wallclock.second_elapsed(tsc);
 
-		// Convert the value of hour into 24 hour format if it is in 12 hour format
-		if (is_24) {
-			// Add 12 hours if the hour is pm i.e. 0x80 bit is set
-			tp.hours = ((tp.hours & 0x7F) + 12*((tp.hours & 0x80)>>7)) % 24;
-		}
+        if (wallclock.calibrated() && (rtc->_seconds++ % RTC_RESYNC_INTERVAL) != 0) return;
 
+        rtc->read_CMOS(rtc->_cache);
+        rtc->convert_format(rtc->_cache);
+        rtc->_cache_valid = true;
+
+        wallclock.synchronise(rtc->_cache, tsc);
     }
+
+    // The current time, as of the last time the registers were read by the interrupt handler
+    RTCTimePoint _cache;
+    bool _cache_valid;
+
+    // The number of update-ended interrupts since the wall clock was first calibrated
+    unsigned int _seconds;
 };
 
 const DeviceClass CMOSRTC::CMOSRTCDeviceClass(RTC::RTCDeviceClass, "cmos-rtc");
@@ -0,0 +1,27 @@
+/*
+ * QEMU Debug Console
+ *
+ * Writes text straight to QEMU's debug console (port 0xE9), which bench.sh
+ * captures with -debugcon, so that results reach the host without going
+ * through the system log.  Without a debug console, the writes go nowhere.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <infos/util/lock.h>
+#include <arch/x86/pio.h>
+
+#define DEBUGCON_PORT	0xE9
+
+/**
+ * Writes text to the debug console.  Each write is kept in one piece, so that lines
+ * from different writers do not interleave.
+ */
+static inline void debugcon_write(const char *data, size_t size)
+{
+	infos::util::UniqueIRQLock l;
+
+	for (size_t i = 0; i < size; i++) {
+		infos::arch::x86::__outb(DEBUGCON_PORT, data[i]);
+	}
+}
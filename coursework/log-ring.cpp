@@ -0,0 +1,362 @@
+/*
+ * Kernel Log Ring
+ *
+ * Each CPU has a ring of fixed-size records.  Writers reserve a slot by
+ * advancing the ring's head with a compare-and-swap (so an interrupt handler
+ * that logs while the code it interrupted is half way through a record simply
+ * takes the next slot), fill it in, and publish it by storing its sequence
+ * number.  The drainer thread consumes records in order, stopping at the first
+ * one that has not been published yet.  If the ring is full, a writer that can
+ * give up the CPU (so that the drainer can catch up) does so, for a bounded
+ * number of times, so that bursts such as the buddy allocator's dump_state get
+ * through; otherwise, the record is dropped and counted.  Writers wake the
+ * drainer once the ring is filling up, and the CMOS RTC's periodic interrupt
+ * asks it to flush what is waiting every LOG_RING_DRAIN_INTERVAL_NS, whichever
+ * scheduler is running.
+ *
+ * Boot with logring.sync=1 to bypass the ring and log synchronously, e.g. to
+ * compare timings.  The logring device reports how many records were written
+ * and dropped.
+ */
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/kernel/process.h>
+#include <infos/kernel/sched.h>
+#include <infos/kernel/thread.h>
+#include <infos/util/cmdline.h>
+#include <infos/util/lock.h>
+#include <infos/util/printf.h>
+#include <infos/util/string.h>
+
+#include "log-ring.h"
+#include "snapshot-device.h"
+#include "thread-sleep.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::util;
+
+// InfOS runs on a single CPU, so there is one ring; the layout allows for more.
+#define LOG_RING_CPUS			1
+#define LOG_RING_SIZE			4096		// Records per ring, a power of two
+
+// Writers wake the drainer once this many records are waiting.
+#define LOG_RING_WAKE_THRESHOLD	(LOG_RING_SIZE / 4)
+
+// The RTC asks the drainer to flush waiting records this often: 100ms
+#define LOG_RING_DRAIN_INTERVAL_NS	100000000ull
+
+// How many times a writer that finds the ring full gives up the CPU to the drainer,
+// before dropping its record.
+#define LOG_RING_FULL_WAITS		64
+
+static bool log_ring_sync;
+
+RegisterCmdLineArgument(LogRingSync, "logring.sync") {
+	if (strncmp(value, "1", 1) == 0) {
+		log_ring_sync = true;
+	}
+}
+
+/**
+ * A log record.  A record holds either a format string and its arguments, or (if
+ * fmt is NULL) a copy of the text.
+ */
+struct LogRecord
+{
+	volatile uint64_t seq;		// One more than the record's position, once published
+	Log *log;
+	const char *fmt;
+	LogLevel::LogLevel level;
+	unsigned int nr_args;
+
+	union {
+		uint64_t args[LOG_RECORD_MAX_ARGS];
+		char text[LOG_RECORD_TEXT_SIZE];
+	};
+};
+
+struct LogRing
+{
+	volatile uint64_t head;		// The next position to be reserved
+	volatile uint64_t tail;		// The next position to be drained
+	volatile uint64_t written, dropped;
+
+	LogRecord records[LOG_RING_SIZE];
+};
+
+static LogRing rings[LOG_RING_CPUS];
+
+static Thread *drainer;
+static volatile bool drainer_idle;
+static volatile bool flush_requested;
+static uint64_t next_flush_ns;
+
+static inline LogRing& this_cpu_ring()
+{
+	return rings[0];
+}
+
+static inline bool irqs_enabled()
+{
+	unsigned long flags;
+	asm volatile("pushf; pop %0" : "=r"(flags));
+
+	return flags & (1 << 9);
+}
+
+static void wake_drainer()
+{
+	drainer_idle = false;
+	wake_thread(*drainer);
+}
+
+/**
+ * Gives up the CPU to the drainer, so that it can make room in a full ring.  Only a
+ * writer with interrupts enabled (i.e. not an interrupt handler, nor the scheduler)
+ * may wait, and never the drainer itself.
+ * @return Returns FALSE if the writer cannot wait.
+ */
+static bool wait_for_drainer()
+{
+	if (!drainer || !irqs_enabled() || &Thread::current() == drainer) return false;
+
+	UniqueIRQLock l;
+
+	if (drainer_idle) wake_drainer();
+	sys.scheduler().schedule();
+
+	return true;
+}
+
+/**
+ * Reserves the next slot in the current CPU's ring, waiting for the drainer to make
+ * room if the ring is full and the writer can wait.
+ * @return Returns the slot, or NULL if the ring is full.
+ */
+static LogRecord *reserve(LogRing& ring, uint64_t& position)
+{
+	unsigned int waits = 0;
+	uint64_t head = ring.head;
+
+	while (true) {
+		if (head - ring.tail >= LOG_RING_SIZE) {
+			if (waits < LOG_RING_FULL_WAITS && wait_for_drainer()) {
+				waits++;
+				head = ring.head;
+				continue;
+			}
+
+			__atomic_fetch_add(&ring.dropped, 1, __ATOMIC_RELAXED);
+			return NULL;
+		}
+
+		if (__atomic_compare_exchange_n(&ring.head, &head, head + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) break;
+	}
+
+	position = head;
+	return &ring.records[head & (LOG_RING_SIZE - 1)];
+}
+
+/**
+ * Publishes a filled-in record, and wakes the drainer if it is time to.  The drainer
+ * is only woken when interrupts are enabled, because a writer with interrupts
+ * disabled may be inside the scheduler; otherwise, the next writer or the RTC
+ * wakes it.
+ */
+static void publish(LogRing& ring, LogRecord *record, uint64_t position)
+{
+	__atomic_store_n(&record->seq, position + 1, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&ring.written, 1, __ATOMIC_RELAXED);
+
+	if (drainer && drainer_idle && irqs_enabled() &&
+			(ring.head - ring.tail >= LOG_RING_WAKE_THRESHOLD || record->level >= LogLevel::WARNING)) {
+		UniqueIRQLock l;
+		if (drainer_idle) wake_drainer();
+	}
+}
+
+void log_ring_append(Log& log, LogLevel::LogLevel level, const char *fmt, const uint64_t *args, unsigned int nr_args)
+{
+	if (log_ring_sync) {
+		// The caller only supplied nr_args arguments, so pad them out to the full set.
+		uint64_t padded[LOG_RECORD_MAX_ARGS];
+		for (unsigned int i = 0; i < LOG_RECORD_MAX_ARGS; i++) {
+			padded[i] = i < nr_args ? args[i] : 0;
+		}
+
+		log.messagef(level, fmt, padded[0], padded[1], padded[2], padded[3], padded[4], padded[5]);
+		return;
+	}
+
+	LogRing& ring = this_cpu_ring();
+	uint64_t position;
+
+	LogRecord *record = reserve(ring, position);
+	if (!record) return;
+
+	record->log = &log;
+	record->fmt = fmt;
+	record->level = level;
+	record->nr_args = nr_args;
+
+	for (unsigned int i = 0; i < LOG_RECORD_MAX_ARGS; i++) {
+		record->args[i] = i < nr_args ? args[i] : 0;
+	}
+
+	publish(ring, record, position);
+}
+
+void klog_text(Log& log, LogLevel::LogLevel level, const char *text)
+{
+	if (log_ring_sync) {
+		log.messagef(level, "%s", text);
+		return;
+	}
+
+	LogRing& ring = this_cpu_ring();
+	uint64_t position;
+
+	LogRecord *record = reserve(ring, position);
+	if (!record) return;
+
+	record->log = &log;
+	record->fmt = NULL;
+	record->level = level;
+	record->nr_args = 0;
+
+	unsigned int i;
+	for (i = 0; text[i] && i < LOG_RECORD_TEXT_SIZE - 1; i++) {
+		record->text[i] = text[i];
+	}
+	record->text[i] = 0;
+
+	publish(ring, record, position);
+}
+
+void log_ring_tick(uint64_t now_ns)
+{
+	if (!drainer || now_ns < next_flush_ns) return;
+
+	next_flush_ns = now_ns + LOG_RING_DRAIN_INTERVAL_NS;
+
+	for (unsigned int cpu = 0; cpu < LOG_RING_CPUS; cpu++) {
+		if (rings[cpu].head != rings[cpu].tail) {
+			flush_requested = true;
+			if (drainer_idle) wake_drainer();
+			break;
+		}
+	}
+}
+
+/**
+ * Writes out the published records of one ring.
+ * @return Returns the number of records written.
+ */
+static unsigned int drain(LogRing& ring)
+{
+	unsigned int drained = 0;
+
+	while (ring.tail != ring.head) {
+		uint64_t position = ring.tail;
+		LogRecord *slot = &ring.records[position & (LOG_RING_SIZE - 1)];
+
+		if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != position + 1) break;
+
+		// Copy the record out and free its slot before the (slow) write.
+		LogRecord record = *slot;
+		__atomic_store_n(&ring.tail, position + 1, __ATOMIC_RELEASE);
+
+		if (record.fmt) {
+			char line[256];
+			snprintf(line, sizeof(line), record.fmt, record.args[0], record.args[1], record.args[2],
+					record.args[3], record.args[4], record.args[5]);
+
+			record.log->messagef(record.level, "%s", line);
+		} else {
+			record.log->messagef(record.level, "%s", record.text);
+		}
+
+		drained++;
+	}
+
+	return drained;
+}
+
+static void drainer_thread_proc(void *arg)
+{
+	uint64_t reported_dropped[LOG_RING_CPUS] = { 0 };
+
+	while (true) {
+		unsigned int drained = 0;
+
+		flush_requested = false;
+
+		for (unsigned int cpu = 0; cpu < LOG_RING_CPUS; cpu++) {
+			drained += drain(rings[cpu]);
+
+			if (rings[cpu].dropped != reported_dropped[cpu]) {
+				reported_dropped[cpu] = rings[cpu].dropped;
+				syslog.messagef(LogLevel::WARNING, "logring: %lu records dropped so far", reported_dropped[cpu]);
+			}
+		}
+
+		UniqueIRQLock l;
+
+		bool pending = false;
+		for (unsigned int cpu = 0; cpu < LOG_RING_CPUS; cpu++) {
+			if (rings[cpu].head != rings[cpu].tail) pending = true;
+		}
+
+		// Carry on while records are still coming in, or if the RTC asked for a flush while
+		// the drainer was busy.  Otherwise, sleep until a writer or the RTC wakes the
+		// drainer; that includes the case where the next record is reserved but its writer
+		// has not published it yet.
+		if (flush_requested || (pending && drained)) continue;
+
+		drainer_idle = true;
+		sleep_current();
+		drainer_idle = false;
+	}
+}
+
+/**
+ * Starts the drainer, and reports the ring's counters when read.
+ */
+class LogRingDevice : public SnapshotDevice<256>
+{
+public:
+	static const DeviceClass LogRingDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return LogRingDeviceClass;
+	}
+
+	bool init(DeviceManager& dm) override
+	{
+		drainer = sys.kernel_process().create_thread(ThreadPrivilege::Kernel, (Thread::thread_proc_t)drainer_thread_proc, "logring");
+		if (!drainer) {
+			syslog.messagef(LogLevel::ERROR, "logring: unable to create the drainer thread");
+			return false;
+		}
+
+		drainer->start(0);
+		return true;
+	}
+
+private:
+	void snapshot() override
+	{
+		clear();
+
+		for (unsigned int cpu = 0; cpu < LOG_RING_CPUS; cpu++) {
+			append("cpu%u: written=%lu dropped=%lu pending=%lu\n",
+					cpu, rings[cpu].written, rings[cpu].dropped, rings[cpu].head - rings[cpu].tail);
+		}
+	}
+};
+
+const DeviceClass LogRingDevice::LogRingDeviceClass(CharacterDevice::CharacterDeviceClass, "logring");
+
+RegisterDevice(LogRingDevice);
@@ -0,0 +1,55 @@
+/*
+ * Kernel Log Ring
+ *
+ * Deferred logging for hot paths.  klog() appends a small binary record (the
+ * log, level, format string and up to LOG_RECORD_MAX_ARGS integer or pointer
+ * arguments) to a per-CPU ring buffer, without taking a lock; a background
+ * kernel thread later formats the records and writes them to their log.  The
+ * caller pays for a few stores instead of formatting and port I/O, so debug
+ * logging barely disturbs the timing being debugged.
+ *
+ * Because formatting is deferred, the format string and any %s arguments must
+ * outlive the call (i.e. be string literals).  For text that is built on the
+ * fly, klog_text() copies up to LOG_RECORD_TEXT_SIZE - 1 characters into the
+ * record instead.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <infos/kernel/log.h>
+
+#define LOG_RECORD_MAX_ARGS		6
+#define LOG_RECORD_TEXT_SIZE	(LOG_RECORD_MAX_ARGS * sizeof(uint64_t) + 40)
+
+/**
+ * Appends a formatted record to the current CPU's log ring.  Use klog() instead.
+ */
+extern void log_ring_append(infos::kernel::Log& log, infos::kernel::LogLevel::LogLevel level,
+		const char *fmt, const uint64_t *args, unsigned int nr_args);
+
+/**
+ * Appends a text record to the current CPU's log ring.
+ * @param text The text of the message, which is copied, and truncated if necessary.
+ */
+extern void klog_text(infos::kernel::Log& log, infos::kernel::LogLevel::LogLevel level, const char *text);
+
+/**
+ * Asks the drainer to flush any waiting records, if LOG_RING_DRAIN_INTERVAL_NS has
+ * passed since it was last asked.  Called from the CMOS RTC's periodic interrupt,
+ * so that records are flushed whichever scheduler is running.
+ * @param now_ns The current system runtime, in nanoseconds.
+ */
+extern void log_ring_tick(uint64_t now_ns);
+
+/**
+ * Logs a message through the log ring.  Takes the same arguments as Log::messagef,
+ * subject to the restrictions above.
+ */
+template<typename... Args>
+static inline void klog(infos::kernel::Log& log, infos::kernel::LogLevel::LogLevel level, const char *fmt, Args... args)
+{
+	static_assert(sizeof...(args) <= LOG_RECORD_MAX_ARGS, "too many arguments for a log record");
+
+	const uint64_t values[] = { 0, ((uint64_t)args)... };
+	log_ring_append(log, level, fmt, values + 1, sizeof...(args));
+}
@@ -0,0 +1,79 @@
+/*
+ * QEMU Debug Devices
+ *
+ * Character devices that let a user program talk to QEMU directly, for running
+ * benchmarks headless: the debugcon device copies everything written to it to
+ * QEMU's debug console, and the qemu-exit device shuts QEMU down through the
+ * isa-debug-exit device, with the first byte written as the exit code.  QEMU
+ * must be started with:
+ *
+ *   -device isa-debug-exit,iobase=0xf4,iosize=0x04
+ */
+#include <infos/drivers/char/char-device.h>
+#include <arch/x86/pio.h>
+
+#include "debugcon.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::arch::x86;
+
+#define DEBUG_EXIT_PORT	0xF4
+
+class DebugConsoleDevice : public CharacterDevice
+{
+public:
+	static const DeviceClass DebugConsoleDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return DebugConsoleDeviceClass;
+	}
+
+	int read(void *buffer, size_t size) override
+	{
+		return -1;
+	}
+
+	int write(const void *buffer, size_t size) override
+	{
+		debugcon_write((const char *)buffer, size);
+		return size;
+	}
+};
+
+class QEMUExitDevice : public CharacterDevice
+{
+public:
+	static const DeviceClass QEMUExitDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return QEMUExitDeviceClass;
+	}
+
+	int read(void *buffer, size_t size) override
+	{
+		return -1;
+	}
+
+	/**
+	 * Exits QEMU.  QEMU's own exit status will be (code << 1) | 1.
+	 * @param buffer The first byte is the exit code.
+	 */
+	int write(const void *buffer, size_t size) override
+	{
+		if (size < 1) return -1;
+
+		__outb(DEBUG_EXIT_PORT, *(const uint8_t *)buffer);
+
+		// Only reached when QEMU has no isa-debug-exit device.
+		return -1;
+	}
+};
+
+const DeviceClass DebugConsoleDevice::DebugConsoleDeviceClass(CharacterDevice::CharacterDeviceClass, "debugcon");
+const DeviceClass QEMUExitDevice::QEMUExitDeviceClass(CharacterDevice::CharacterDeviceClass, "qemu-exit");
+
+RegisterDevice(DebugConsoleDevice);
+RegisterDevice(QEMUExitDevice);
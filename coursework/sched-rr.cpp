@@ -6,74 +6,12 @@
 /*
  * STUDENT NUMBER: s1768094
  */
-#include <infos/kernel/sched.h>
-#include <infos/kernel/thread.h>
-#include <infos/kernel/log.h>
-#include <infos/util/list.h>
-#include <infos/util/lock.h>
+#include "sched-rr.h"
 
 using namespace infos::kernel;
 using namespace infos::util;
 
-/**
- * A round-robin scheduling algorithm
- */
-class RoundRobinScheduler : public SchedulingAlgorithm
-{
-public:
-	/**
-	 * Returns the friendly name of the algorithm, for debugging and selection purposes.
-	 */
-	const char* name() const override { return "rr"; }
-
-	/**
-	 * Called when a scheduling entity becomes eligible for running.
-	 * @param entity
-	 */
-	void add_to_runqueue(SchedulingEntity& entity) override
-	{
-		UniqueIRQLock l;
-		runqueue.enqueue(&entity);
-	}
-
-	/**
-	 * Called when a scheduling entity is no longer eligible for running.
-	 * @param entity
-	 */
-	void remove_from_runqueue(SchedulingEntity& entity) override
-	{
-		UniqueIRQLock l;
-		runqueue.remove(&entity);
-	}
-
-	/**
-	 * Called every time a scheduling event occurs, to cause the next eligible entity
-	 * to be chosen.  The next eligible entity might actually be the same entity, if
-	 * e.g. its timeslice has not expired.
-	 */
-	SchedulingEntity *pick_next_entity() override
-	{
-		// Empty run queue
-		if (runqueue.count() == 0) return NULL;
-
-		// Require a lock on the queue before manipulate it
-		UniqueIRQLock l;
-
-		// Pop the first entity in the queue, and push it to the end of the queue 
-		runqueue.enqueue(runqueue.dequeue());
-		
-		// Return the first entity in the queue as the next entity to run
-		// Alternatively, we can return the last entity (i.e. the one just popped out 
-		// and pushed back). The difference is that this implementation will allow the first 
-		// entity to run one timeslice more if the second entity is added during the last 
-		// time slice when there is only one entity in the queue
-		return runqueue.first();
-	}
-
-private:
-	// A list containing the current runqueue.
-	List<SchedulingEntity *> runqueue;
-};
+RoundRobinScheduler *RoundRobinScheduler::static_scheduler;
 
 /* --- DO NOT CHANGE ANYTHING BELOW THIS LINE --- */
 
@@ -0,0 +1,143 @@
+/*
+ * Round-robin Scheduling Algorithm
+ * SKELETON IMPLEMENTATION -- TO BE FILLED IN FOR TASK (1)
+ */
+
+/*
+ * STUDENT NUMBER: s1768094
+ */
+#pragma once
+
+#include <infos/kernel/sched.h>
+#include <infos/kernel/thread.h>
+#include <infos/kernel/log.h>
+#include <infos/util/list.h>
+#include <infos/util/lock.h>
+
+#include "boot-trace.h"
+#include "sched-stats.h"
+
+/*
+ * The class lives in a header, so that a statically bound build can inline it into
+ * the entry points in static-algorithms.h.
+ */
+namespace rr_scheduler
+{
+	using namespace infos::kernel;
+	using namespace infos::util;
+
+	/**
+	 * A round-robin scheduling algorithm
+	 */
+	class RoundRobinScheduler final : public SchedulingAlgorithm
+	{
+	public:
+		/**
+		 * Constructs a new instance of the round-robin scheduler.
+		 */
+		RoundRobinScheduler() : stats("rr")
+		{
+			boot_trace("register-scheduler rr");
+		}
+
+		/**
+		 * Called when the scheduler selects this algorithm.
+		 */
+		void init() override
+		{
+			static_scheduler = this;
+		}
+
+		/**
+		 * Returns the friendly name of the algorithm, for debugging and selection purposes.
+		 */
+		const char* name() const override { return "rr"; }
+
+		/**
+		 * Called when a scheduling entity becomes eligible for running.
+		 * @param entity
+		 */
+		void add_to_runqueue(SchedulingEntity& entity) override
+		{
+			UniqueIRQLock l;
+			runqueue.enqueue(&entity);
+			stats.entity_woken(entity);
+		}
+
+		/**
+		 * Called when a group of scheduling entities become eligible for running at the
+		 * same time, e.g. on an event broadcast or a barrier release.  The whole group is
+		 * appended to the runqueue under a single acquisition of the runqueue lock.
+		 *
+		 * The kernel's SchedulingAlgorithm does not declare this hook (hence no override),
+		 * and its scheduler core does not call it yet; only the scheduler simulator does.
+		 * @param entities The entities to add, in the order in which they should run.
+		 */
+		void add_to_runqueue_batch(const List<SchedulingEntity *>& entities)
+		{
+			UniqueIRQLock l;
+
+			for (const auto& entity : entities) {
+				runqueue.enqueue(entity);
+				stats.entity_woken(*entity);
+			}
+		}
+
+		/**
+		 * Called when a scheduling entity is no longer eligible for running.
+		 * @param entity
+		 */
+		void remove_from_runqueue(SchedulingEntity& entity) override
+		{
+			UniqueIRQLock l;
+			runqueue.remove(&entity);
+			stats.entity_blocked(entity);
+		}
+
+		/**
+		 * Called every time a scheduling event occurs, to cause the next eligible entity
+		 * to be chosen.  The next eligible entity might actually be the same entity, if
+		 * e.g. its timeslice has not expired.
+		 */
+		SchedulingEntity *pick_next_entity() override
+		{
+			// Require a lock on the queue before manipulate it
+			UniqueIRQLock l;
+
+			// Account the time spent choosing the next entity
+			SchedStatsTimer timer(stats);
+
+			// Empty run queue
+			if (runqueue.count() == 0) {
+				stats.entity_picked(NULL, 0);
+				return NULL;
+			}
+
+			// Pop the first entity in the queue, and push it to the end of the queue 
+			runqueue.enqueue(runqueue.dequeue());
+			
+			// Return the first entity in the queue as the next entity to run
+			// Alternatively, we can return the last entity (i.e. the one just popped out 
+			// and pushed back). The difference is that this implementation will allow the first 
+			// entity to run one timeslice more if the second entity is added during the last 
+			// time slice when there is only one entity in the queue
+			SchedulingEntity *next = runqueue.first();
+			stats.entity_picked(next, runqueue.count());
+
+			return next;
+		}
+
+		// The selected instance (NULL until the scheduler initialises it), reached directly by
+		// the entry points in static-algorithms.h when the scheduler is bound at compile time.
+		static RoundRobinScheduler *static_scheduler;
+
+	private:
+		// A list containing the current runqueue.
+		List<SchedulingEntity *> runqueue;
+
+		// Latency and runqueue statistics, exported through the sched-stats device.
+		SchedStats stats;
+	};
+}
+
+using rr_scheduler::RoundRobinScheduler;
@@ -0,0 +1,113 @@
+/*
+ * Scheduler Instrumentation
+ * Statistics registry, and the sched-stats character device that exports it.
+ */
+#include <infos/util/lock.h>
+
+#include "sched-stats.h"
+#include "snapshot-device.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::util;
+
+#define MAX_SCHED_STATS	8
+
+static SchedStats *registered_stats[MAX_SCHED_STATS];
+static unsigned int nr_registered_stats;
+
+SchedStats::SchedStats(const char *algorithm)
+	: _algorithm(algorithm), _current(NULL), _current_blocked(false)
+{
+	for (unsigned int i = 0; i < NR_SLOTS; i++) {
+		_slots[i].entity = NULL;
+		_slots[i].woken_at = 0;
+	}
+
+	if (nr_registered_stats < MAX_SCHED_STATS) {
+		registered_stats[nr_registered_stats++] = this;
+	}
+}
+
+unsigned int SchedStats::nr_registered()
+{
+	return nr_registered_stats;
+}
+
+SchedStats *SchedStats::registered(unsigned int index)
+{
+	return index < nr_registered_stats ? registered_stats[index] : NULL;
+}
+
+/**
+ * A character device that renders a text snapshot of every registered scheduler's
+ * statistics.  Each read continues the current snapshot; once it has been fully
+ * consumed, the next read takes a new one.  Writing anything to the device resets
+ * the counters.
+ */
+class SchedStatsDevice : public SnapshotDevice<4096>
+{
+public:
+	static const DeviceClass SchedStatsDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return SchedStatsDeviceClass;
+	}
+
+	int write(const void *buffer, size_t size) override
+	{
+		UniqueIRQLock l;
+
+		for (unsigned int i = 0; i < SchedStats::nr_registered(); i++) {
+			SchedStats::registered(i)->counters.reset();
+		}
+
+		return size;
+	}
+
+private:
+	void append_histogram(const char *title, const SchedHistogram& h)
+	{
+		append("  %s: n=%lu mean=%lu p50<=%lu p99<=%lu max=%lu\n", title,
+				h.count(), h.mean(), h.percentile(50), h.percentile(99), h.max());
+
+		if (h.count() == 0) return;
+
+		append("   ");
+		for (unsigned int i = 0; i < SchedHistogram::NR_BUCKETS; i++) {
+			if (h.bucket(i)) append(" [<2^%u]=%lu", i, h.bucket(i));
+		}
+		append("\n");
+	}
+
+	/**
+	 * Renders the current statistics into the snapshot buffer.  Interrupts are disabled
+	 * whilst the counters are copied, so that the snapshot is consistent.
+	 */
+	void snapshot() override
+	{
+		clear();
+
+		for (unsigned int i = 0; i < SchedStats::nr_registered(); i++) {
+			SchedStats *stats = SchedStats::registered(i);
+			SchedCounters copy;
+			{
+				UniqueIRQLock l;
+				copy = stats->counters;
+			}
+
+			append("%s:\n", stats->algorithm());
+			append("  picks=%lu switches=%lu voluntary=%lu involuntary=%lu\n",
+					copy.picks, copy.context_switches, copy.voluntary_switches, copy.involuntary_switches);
+
+			append_histogram("wakeup-latency-ns", copy.wakeup_latency);
+			append_histogram("runqueue-length", copy.runqueue_length);
+			append_histogram("sched-cycles", copy.sched_cycles);
+		}
+	}
+};
+
+const DeviceClass SchedStatsDevice::SchedStatsDeviceClass(CharacterDevice::CharacterDeviceClass, "sched-stats");
+
+RegisterDevice(SchedStatsDevice);
@@ -0,0 +1,246 @@
+/*
+ * Scheduler Instrumentation
+ *
+ * Cheap counters and histograms that a scheduling algorithm embeds in itself
+ * and updates from its runqueue hooks.  Each algorithm instance owns the
+ * runqueue of the CPU it schedules on, so an embedded SchedStats is the
+ * per-CPU view of that algorithm.  Snapshots are exported through the
+ * sched-stats device (see sched-stats.cpp).
+ */
+#pragma once
+
+#include <infos/kernel/sched-entity.h>
+#include <infos/kernel/kernel.h>
+
+#include "tsc.h"
+
+/**
+ * A power-of-two bucketed histogram.  Bucket i counts samples in the range
+ * [2^(i-1), 2^i), with bucket 0 counting samples of exactly zero.
+ */
+class SchedHistogram
+{
+public:
+	static const unsigned int NR_BUCKETS = 32;
+
+	SchedHistogram() { reset(); }
+
+	/**
+	 * Records a single sample in the histogram.
+	 * @param value The value of the sample.
+	 */
+	void record(uint64_t value)
+	{
+		unsigned int bucket = value ? 64 - __builtin_clzll(value) : 0;
+		if (bucket >= NR_BUCKETS) bucket = NR_BUCKETS - 1;
+
+		_buckets[bucket]++;
+		_count++;
+		_sum += value;
+		if (value > _max) _max = value;
+	}
+
+	/**
+	 * Clears all the samples in the histogram.
+	 */
+	void reset()
+	{
+		for (unsigned int i = 0; i < NR_BUCKETS; i++) {
+			_buckets[i] = 0;
+		}
+
+		_count = 0;
+		_sum = 0;
+		_max = 0;
+	}
+
+	uint64_t bucket(unsigned int i) const { return _buckets[i]; }
+	uint64_t count() const { return _count; }
+	uint64_t sum() const { return _sum; }
+	uint64_t max() const { return _max; }
+	uint64_t mean() const { return _count ? _sum / _count : 0; }
+
+	/**
+	 * Returns the upper bound of the bucket that contains the given percentile, clamped
+	 * to the largest sample seen.
+	 * @param pct The percentile to look up, between 0 and 100.
+	 */
+	uint64_t percentile(unsigned int pct) const
+	{
+		if (_count == 0) return 0;
+
+		uint64_t target = (_count * pct + 99) / 100;
+		uint64_t seen = 0;
+		for (unsigned int i = 0; i < NR_BUCKETS; i++) {
+			seen += _buckets[i];
+			if (seen >= target) return i ? min_u64((1ull << i) - 1, _max) : 0;
+		}
+
+		return _max;
+	}
+
+private:
+	static uint64_t min_u64(uint64_t a, uint64_t b) { return a < b ? a : b; }
+
+	uint64_t _buckets[NR_BUCKETS];
+	uint64_t _count, _sum, _max;
+};
+
+/**
+ * The exported counters and histograms of a single runqueue.
+ */
+struct SchedCounters
+{
+	SchedCounters() { reset(); }
+
+	/**
+	 * Clears all counters and histograms.
+	 */
+	void reset()
+	{
+		picks = 0;
+		context_switches = 0;
+		voluntary_switches = 0;
+		involuntary_switches = 0;
+
+		wakeup_latency.reset();
+		runqueue_length.reset();
+		sched_cycles.reset();
+	}
+
+	uint64_t picks;
+	uint64_t context_switches;
+	uint64_t voluntary_switches;
+	uint64_t involuntary_switches;
+
+	SchedHistogram wakeup_latency;		// Nanoseconds from add_to_runqueue to being picked
+	SchedHistogram runqueue_length;		// Runqueue length at each pick_next_entity
+	SchedHistogram sched_cycles;		// TSC cycles spent inside pick_next_entity
+};
+
+/**
+ * Scheduler statistics for a single runqueue.  All of the update methods must be
+ * called with the runqueue lock held.
+ */
+class SchedStats
+{
+public:
+	/**
+	 * Constructs a statistics block, and registers it for export under the given
+	 * algorithm name.
+	 * @param algorithm The friendly name of the owning scheduling algorithm.
+	 */
+	SchedStats(const char *algorithm);
+
+	/**
+	 * Called when an entity is added to the runqueue, to start its wakeup-to-run timer.
+	 * @param entity The entity that has become runnable.
+	 */
+	void entity_woken(infos::kernel::SchedulingEntity& entity)
+	{
+		Slot& slot = slot_for(&entity);
+		slot.entity = &entity;
+		slot.woken_at = now();
+	}
+
+	/**
+	 * Called when an entity is removed from the runqueue.  If the entity is the one
+	 * currently running, the next switch away from it is counted as voluntary.
+	 * @param entity The entity that is no longer runnable.
+	 */
+	void entity_blocked(infos::kernel::SchedulingEntity& entity)
+	{
+		if (&entity == _current) _current_blocked = true;
+
+		Slot& slot = slot_for(&entity);
+		if (slot.entity == &entity) slot.entity = NULL;
+	}
+
+	/**
+	 * Called at the end of every pick_next_entity.
+	 * @param next The entity that was chosen to run, or NULL if the runqueue was empty.
+	 * @param runqueue_length The number of entities on the runqueue at the time of the pick.
+	 */
+	void entity_picked(infos::kernel::SchedulingEntity *next, uint64_t runqueue_length)
+	{
+		counters.picks++;
+		counters.runqueue_length.record(runqueue_length);
+
+		if (next != _current) {
+			counters.context_switches++;
+
+			if (_current) {
+				if (_current_blocked) counters.voluntary_switches++;
+				else counters.involuntary_switches++;
+			}
+		}
+
+		if (next) {
+			Slot& slot = slot_for(next);
+			if (slot.entity == next) {
+				counters.wakeup_latency.record(now() - slot.woken_at);
+				slot.entity = NULL;
+			}
+		}
+
+		_current = next;
+		_current_blocked = false;
+	}
+
+	const char *algorithm() const { return _algorithm; }
+
+	SchedCounters counters;
+
+	/**
+	 * Returns the number of registered statistics blocks.
+	 */
+	static unsigned int nr_registered();
+
+	/**
+	 * Returns the registered statistics block at the given index.
+	 */
+	static SchedStats *registered(unsigned int index);
+
+private:
+	/*
+	 * Wakeup timestamps are kept in a small direct-mapped table keyed on the
+	 * entity address, so that no per-entity storage is required.  A collision
+	 * simply drops the older sample.
+	 */
+	static const unsigned int NR_SLOTS = 256;
+
+	struct Slot {
+		infos::kernel::SchedulingEntity *entity;
+		uint64_t woken_at;
+	};
+
+	Slot& slot_for(infos::kernel::SchedulingEntity *entity)
+	{
+		return _slots[((uint64_t)entity >> 4) % NR_SLOTS];
+	}
+
+	static uint64_t now()
+	{
+		return infos::kernel::sys.runtime().count();
+	}
+
+	const char *_algorithm;
+	infos::kernel::SchedulingEntity *_current;
+	bool _current_blocked;
+	Slot _slots[NR_SLOTS];
+};
+
+/**
+ * Measures the number of TSC cycles spent in the enclosing scope, and records
+ * it in the scheduler-overhead histogram.
+ */
+class SchedStatsTimer
+{
+public:
+	SchedStatsTimer(SchedStats& stats) : _stats(stats), _start(read_tsc()) { }
+	~SchedStatsTimer() { _stats.counters.sched_cycles.record(read_tsc() - _start); }
+
+private:
+	SchedStats& _stats;
+	uint64_t _start;
+};
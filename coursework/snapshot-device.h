@@ -0,0 +1,112 @@
+/*
+ * Snapshot Devices
+ *
+ * A base for the read-only character devices that export a text report of
+ * kernel state (scheduler statistics, the boot timeline, and so on).  The
+ * report is rendered into a fixed-size buffer, and reads walk through it: a
+ * read from the start of the report first calls snapshot(), each further read
+ * continues where the last one stopped, and the read at the end returns zero
+ * and rewinds, so "cat" sees one consistent report.
+ *
+ * Reports that are produced once, e.g. at boot, can also send each line to the
+ * system log and QEMU's debug console as it is added, with report_line().
+ */
+#pragma once
+
+#include <infos/drivers/char/char-device.h>
+#include <infos/kernel/log.h>
+#include <infos/util/printf.h>
+#include <infos/util/string.h>
+
+#include "debugcon.h"
+
+template<size_t BufferSize>
+class SnapshotDevice : public infos::drivers::CharacterDevice
+{
+public:
+	SnapshotDevice() : _length(0), _position(0) { }
+
+	int read(void *buffer, size_t size) override
+	{
+		if (_position == 0) snapshot();
+
+		size_t remaining = _length - _position;
+		if (size > remaining) size = remaining;
+
+		memcpy(buffer, &_buffer[_position], size);
+		_position += size;
+
+		// Start a fresh snapshot on the next read, once this one has been consumed.
+		if (size == 0) _position = 0;
+
+		return size;
+	}
+
+	int write(const void *buffer, size_t size) override
+	{
+		return -1;
+	}
+
+protected:
+	/**
+	 * Called before the report is read from the start.  Devices whose report changes
+	 * override this to clear() and re-render it; by default, the report is left as it is.
+	 */
+	virtual void snapshot() { }
+
+	/**
+	 * Empties the report.
+	 */
+	void clear()
+	{
+		_length = 0;
+	}
+
+	/**
+	 * Appends formatted text to the report.  Text that does not fit is dropped.
+	 */
+	void append(const char *fmt, ...)
+	{
+		va_list args;
+		va_start(args, fmt);
+		append_v(fmt, args);
+		va_end(args);
+	}
+
+	void append_v(const char *fmt, va_list args)
+	{
+		if (_length >= BufferSize - 1) return;
+
+		int n = vsnprintf(&_buffer[_length], BufferSize - _length, fmt, args);
+		if (n < 0) return;
+
+		_length += n;
+		if (_length > BufferSize - 1) _length = BufferSize - 1;
+	}
+
+	/**
+	 * Appends a line to the report, and writes it to the system log and the debug
+	 * console, prefixed with the given tag.
+	 */
+	void report_line(const char *tag, const char *fmt, ...)
+	{
+		char line[160];
+
+		va_list args;
+		va_start(args, fmt);
+		vsnprintf(line, sizeof(line), fmt, args);
+		va_end(args);
+
+		infos::kernel::syslog.messagef(infos::kernel::LogLevel::INFO, "%s: %s", tag, line);
+
+		char tagged[sizeof(line) + 32];
+		int m = snprintf(tagged, sizeof(tagged), "%s: %s\n", tag, line);
+		if (m > 0) debugcon_write(tagged, (size_t)m < sizeof(tagged) ? m : sizeof(tagged) - 1);
+
+		append("%s\n", line);
+	}
+
+private:
+	char _buffer[BufferSize];
+	size_t _length, _position;
+};
@@ -0,0 +1,103 @@
+/*
+ * Static Algorithm Binding
+ *
+ * By default, the page allocation and scheduling algorithms are chosen at
+ * boot, by name, from those registered with RegisterPageAllocator and
+ * RegisterScheduler, and every call into them is virtual.  A build can
+ * instead bind one algorithm of each kind at compile time, with e.g.
+ *
+ *   STATIC_ALGORITHMS="buddy rr" ./build.sh
+ *
+ * which generates static-config.h to define INFOS_STATIC_PGALLOC_BUDDY and
+ * INFOS_STATIC_SCHED_RR (build.sh always generates the file, and leaves it
+ * empty when nothing is bound).  The bound algorithm is still registered (so
+ * that the kernel initialises it as usual, and it must still be the one
+ * selected on the command line), but its hot-path entry points are also
+ * defined below as inline functions.  These call straight into the final
+ * class, whose definition is visible here, so the compiler resolves and
+ * inlines the algorithm into the caller, and kernel call sites can use them
+ * in place of the virtual calls.
+ *
+ * The entry points reach the instance that the kernel selected and
+ * initialised, and panic if they are called before then (or if a different
+ * algorithm was selected on the command line).
+ */
+#pragma once
+
+// The scheduler simulator binds algorithms itself, and ignores the kernel's configuration.
+#if __has_include("static-config.h") && !defined(INFOS_SCHED_SIM)
+#include "static-config.h"
+#endif
+
+#if defined(INFOS_STATIC_PGALLOC_BUDDY)
+#include "buddy.h"
+#define INFOS_STATIC_PGALLOC
+typedef BuddyPageAllocator StaticPageAllocator;
+#endif
+
+#if defined(INFOS_STATIC_SCHED_RR)
+#include "sched-rr.h"
+#define INFOS_STATIC_SCHED
+typedef RoundRobinScheduler StaticScheduler;
+#endif
+
+#ifdef INFOS_STATIC_PGALLOC
+/**
+ * Allocates 2^order contiguous pages from the statically bound allocator.
+ * @param order The power of two, of the number of contiguous pages to allocate.
+ * @return Returns the first page descriptor of the block, or NULL if none was available.
+ */
+static inline infos::mm::PageDescriptor *static_alloc_pages(int order)
+{
+	assert(StaticPageAllocator::static_allocator);
+	return StaticPageAllocator::static_allocator->alloc_pages(order);
+}
+
+/**
+ * Returns 2^order contiguous pages to the statically bound allocator.
+ * @param pgd The first page descriptor of the block.
+ * @param order The power of two, of the number of contiguous pages.
+ */
+static inline void static_free_pages(infos::mm::PageDescriptor *pgd, int order)
+{
+	assert(StaticPageAllocator::static_allocator);
+	StaticPageAllocator::static_allocator->free_pages(pgd, order);
+}
+#endif
+
+#ifdef INFOS_STATIC_SCHED
+/**
+ * Returns TRUE if the given scheduling algorithm is the statically bound one.
+ */
+static inline bool static_scheduler_is(const infos::kernel::SchedulingAlgorithm& algorithm)
+{
+	return &algorithm == StaticScheduler::static_scheduler;
+}
+
+/**
+ * Picks the next entity to run, from the statically bound scheduler.
+ */
+static inline infos::kernel::SchedulingEntity *static_pick_next_entity()
+{
+	assert(StaticScheduler::static_scheduler);
+	return StaticScheduler::static_scheduler->pick_next_entity();
+}
+
+/**
+ * Makes an entity eligible for running, on the statically bound scheduler.
+ */
+static inline void static_add_to_runqueue(infos::kernel::SchedulingEntity& entity)
+{
+	assert(StaticScheduler::static_scheduler);
+	StaticScheduler::static_scheduler->add_to_runqueue(entity);
+}
+
+/**
+ * Stops an entity from being eligible for running, on the statically bound scheduler.
+ */
+static inline void static_remove_from_runqueue(infos::kernel::SchedulingEntity& entity)
+{
+	assert(StaticScheduler::static_scheduler);
+	StaticScheduler::static_scheduler->remove_from_runqueue(entity);
+}
+#endif
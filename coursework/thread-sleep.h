@@ -0,0 +1,73 @@
+/*
+ * Thread Sleeps
+ *
+ * Blocking the current kernel thread until another thread or an interrupt
+ * handler wakes it, optionally with a timeout.  The usual pattern is:
+ *
+ *   while (true) {
+ *       UniqueIRQLock l;
+ *       if (condition) break;
+ *       sleep_current(deadline);
+ *   }
+ *
+ * with the waker setting the condition and calling wake_thread().  Checking
+ * the condition and going to sleep with interrupts disabled means that a
+ * wakeup cannot slip in between the two, and the condition must be re-checked
+ * after every wakeup, since a sleep can end early.
+ */
+#pragma once
+
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/kernel/sched.h>
+#include <infos/kernel/thread.h>
+
+#include "timer-wheel.h"
+
+/**
+ * Puts the current thread to sleep, and switches to another thread, until the thread
+ * is woken, or the deadline passes.  Call with interrupts disabled.
+ * @param deadline_ns The system runtime, in nanoseconds, at which to stop waiting, or
+ * zero to wait until woken.
+ * @return Returns FALSE if the deadline has passed.  A timed sleep is refused, and returns
+ * FALSE straight away, if nothing is driving the sleep wheel (see start_sleep_clock()).
+ */
+static inline bool sleep_current(uint64_t deadline_ns = 0)
+{
+	using namespace infos::kernel;
+
+	Thread& current = Thread::current();
+
+	if (!deadline_ns) {
+		sys.scheduler().set_entity_state(current, SchedulingEntityState::SLEEPING);
+		sys.scheduler().schedule();
+		return true;
+	}
+
+	if (!sleep_clock_running()) {
+		syslog.messagef(LogLevel::ERROR, "sleep: nothing drives the sleep wheel, so the timed sleep would never end");
+		return false;
+	}
+
+	EntityWakeupTimer timer;
+
+	sleep_entity(current, timer, deadline_ns);
+	sys.scheduler().schedule();
+	cancel_sleep(timer);
+
+	return sys.runtime().count() < deadline_ns;
+}
+
+/**
+ * Makes a sleeping thread runnable again.  Does nothing if the thread is not asleep,
+ * so it is safe to call for a thread that has not gone to sleep yet (or has already
+ * been woken).  Safe to call from interrupt handlers.
+ */
+static inline void wake_thread(infos::kernel::Thread& thread)
+{
+	using namespace infos::kernel;
+
+	if (thread.state() == SchedulingEntityState::SLEEPING) {
+		sys.scheduler().set_entity_state(thread, SchedulingEntityState::RUNNABLE);
+	}
+}
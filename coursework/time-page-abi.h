@@ -0,0 +1,31 @@
+/*
+ * Shared Time Page
+ *
+ * The layout of the read-only page through which the kernel publishes the
+ * wall clock to user processes.  This header is shared with user space (it is
+ * linked into infos-user by reset-repo.sh), so it must not depend on any
+ * kernel headers.  unsigned long is 64 bits on both sides.
+ *
+ * The kernel increments seq before and after every update, so it is odd
+ * whilst an update is in progress.  A reader samples seq, copies the fields,
+ * and retries if seq was odd or has changed.  Time is then computed from the
+ * TSC exactly as the kernel's WallClock does:
+ *
+ *   monotonic_ns = mono_base_ns + ((tsc - mono_base_tsc) * ns_per_cycle) >> 32
+ *   realtime_ns  = real_base_ns + (monotonic_ns - real_base_mono_ns)
+ */
+#pragma once
+
+// The virtual address at which the time page is mapped into user processes.
+#define TIME_PAGE_USER_VA	0x7F0000000000ul
+
+struct TimePageData
+{
+	volatile unsigned long seq;
+
+	unsigned long tsc_hz;			// Zero until the TSC has been calibrated
+	unsigned long ns_per_cycle;		// 32.32 fixed-point nanoseconds per TSC cycle
+
+	unsigned long mono_base_ns, mono_base_tsc;
+	unsigned long real_base_ns, real_base_mono_ns;
+};
@@ -0,0 +1,99 @@
+/*
+ * Shared Time Page
+ *
+ * A page of memory, allocated at boot, into which the wall clock publishes its
+ * parameters (see time-page-abi.h).  The page is mapped read-only into a user
+ * process the first time the process reads the timepage device; the read
+ * returns the user address of the mapping.  From then on, the process reads
+ * the time straight from the page, without entering the kernel.
+ */
+#include <infos/drivers/char/char-device.h>
+#include <infos/kernel/kernel.h>
+#include <infos/kernel/log.h>
+#include <infos/kernel/process.h>
+#include <infos/kernel/thread.h>
+#include <infos/mm/mm.h>
+#include <infos/mm/page-allocator.h>
+#include <infos/mm/vma.h>
+#include <infos/util/lock.h>
+#include <infos/util/string.h>
+
+#include "boot-trace.h"
+#include "time-page-abi.h"
+#include "wallclock.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::mm;
+using namespace infos::util;
+
+class TimePageDevice : public CharacterDevice
+{
+public:
+	static const DeviceClass TimePageDeviceClass;
+
+	const DeviceClass& device_class() const override
+	{
+		return TimePageDeviceClass;
+	}
+
+	TimePageDevice() : _page_pgd(NULL) { }
+
+	/**
+	 * Allocates the time page, and hands it to the wall clock to keep up to date.
+	 */
+	bool init(DeviceManager& dm) override
+	{
+		BootTraceScope trace("timepage.init");
+
+		_page_pgd = sys.mm().pgalloc().alloc_pages(0);
+		if (!_page_pgd) {
+			syslog.messagef(LogLevel::ERROR, "timepage: unable to allocate the time page");
+			return false;
+		}
+
+		TimePageData *page = (TimePageData *)sys.mm().pgalloc().pgd_to_vpa(_page_pgd);
+		memset(page, 0, 0x1000);
+
+		wallclock.publish(page);
+		return true;
+	}
+
+	/**
+	 * Maps the time page into the calling process, if it is not already mapped, and
+	 * returns the user address of the mapping.
+	 * @param buffer Receives the address of the time page, as an unsigned long.
+	 * @param size The size of the buffer, which must be large enough for an address.
+	 */
+	int read(void *buffer, size_t size) override
+	{
+		if (size < sizeof(unsigned long)) return -1;
+
+		Process& process = Thread::current().owner();
+		phys_addr_t pa = sys.mm().pgalloc().pgd_to_pfn(_page_pgd) << 12;
+
+		{
+			UniqueIRQLock l;
+
+			// The page is mapped present and user-accessible, but not writable.
+			if (!process.vma().is_mapped(TIME_PAGE_USER_VA)) {
+				process.vma().insert_mapping(TIME_PAGE_USER_VA, pa, MappingFlags::Present | MappingFlags::User);
+			}
+		}
+
+		*(unsigned long *)buffer = TIME_PAGE_USER_VA;
+		return sizeof(unsigned long);
+	}
+
+	int write(const void *buffer, size_t size) override
+	{
+		return -1;
+	}
+
+private:
+	PageDescriptor *_page_pgd;
+};
+
+const DeviceClass TimePageDevice::TimePageDeviceClass(CharacterDevice::CharacterDeviceClass, "timepage");
+
+RegisterDevice(TimePageDevice);
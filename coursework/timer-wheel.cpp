@@ -0,0 +1,196 @@
+/*
+ * Hierarchical Timer Wheel
+ */
+#include <infos/kernel/kernel.h>
+#include <infos/util/lock.h>
+
+#include "timer-wheel.h"
+
+using namespace infos::kernel;
+using namespace infos::util;
+
+// The largest distance, in ticks, that the top level of the wheel can represent.
+#define TIMER_WHEEL_MAX_DELTA	((1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+// The resolution of the wheel of sleeping entities: one millisecond.
+#define SLEEP_RESOLUTION_NS		1000000
+
+static TimerWheel sleepers(SLEEP_RESOLUTION_NS);
+static volatile bool sleep_clock;
+
+TimerWheel::TimerWheel(uint64_t resolution_ns) : _resolution_ns(resolution_ns), _current(0), _count(0)
+{
+	// Each bucket is an empty circular list.
+	for (unsigned int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+		for (unsigned int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+			_buckets[level][slot].next = &_buckets[level][slot];
+			_buckets[level][slot].prev = &_buckets[level][slot];
+		}
+	}
+}
+
+void TimerWheel::link(TimerLink& head, TimerLink& entry)
+{
+	entry.next = &head;
+	entry.prev = head.prev;
+	head.prev->next = &entry;
+	head.prev = &entry;
+}
+
+void TimerWheel::unlink(TimerLink& entry)
+{
+	entry.prev->next = entry.next;
+	entry.next->prev = entry.prev;
+	entry.next = entry.prev = NULL;
+}
+
+/**
+ * Places an armed timer into the bucket that matches the distance between its
+ * expiry tick and the current tick.
+ */
+void TimerWheel::enqueue(Timer& timer)
+{
+	uint64_t expires = timer._expires;
+	unsigned int level, slot;
+
+	if (expires < _current) {
+		// Already due: fire on the next tick to be processed.
+		level = 0;
+		slot = _current & TIMER_WHEEL_SLOT_MASK;
+	} else {
+		uint64_t delta = expires - _current;
+
+		// Timers beyond the reach of the wheel are parked at its far edge, and will
+		// be re-cascaded when that bucket comes round.
+		if (delta > TIMER_WHEEL_MAX_DELTA) {
+			expires = _current + TIMER_WHEEL_MAX_DELTA;
+			delta = TIMER_WHEEL_MAX_DELTA;
+		}
+
+		level = 0;
+		while (delta >= (1ull << ((level + 1) * TIMER_WHEEL_SLOT_BITS))) {
+			level++;
+		}
+
+		slot = (expires >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+	}
+
+	link(_buckets[level][slot], timer);
+}
+
+void TimerWheel::insert(Timer& timer, uint64_t deadline_ns)
+{
+	if (timer.armed()) cancel(timer);
+
+	timer._expires = (deadline_ns + _resolution_ns - 1) / _resolution_ns;
+
+	enqueue(timer);
+	_count++;
+}
+
+void TimerWheel::cancel(Timer& timer)
+{
+	if (!timer.armed()) return;
+
+	unlink(timer);
+	_count--;
+}
+
+/**
+ * Moves every timer in the current bucket of the given level into the levels
+ * below it.
+ * @return Returns the index of the bucket that was cascaded.
+ */
+unsigned int TimerWheel::cascade(unsigned int level)
+{
+	unsigned int slot = (_current >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+	TimerLink& head = _buckets[level][slot];
+
+	while (head.next != &head) {
+		Timer& timer = *(Timer *)head.next;
+
+		unlink(timer);
+		enqueue(timer);
+	}
+
+	return slot;
+}
+
+void TimerWheel::advance(uint64_t now_ns)
+{
+	uint64_t target = now_ns / _resolution_ns;
+
+	while (_current <= target) {
+		// Nothing to fire, so skip straight to the target.
+		if (_count == 0) {
+			_current = target + 1;
+			break;
+		}
+
+		// When the lowest level wraps, refill it from the level above, and so on up.
+		unsigned int slot = _current & TIMER_WHEEL_SLOT_MASK;
+		for (unsigned int level = 1; slot == 0 && level < TIMER_WHEEL_LEVELS; level++) {
+			slot = cascade(level);
+		}
+
+		TimerLink& head = _buckets[0][_current & TIMER_WHEEL_SLOT_MASK];
+		_current++;
+
+		// Timers are detached before they are fired, so an expiry handler is free to
+		// re-arm its own timer.
+		while (head.next != &head) {
+			Timer& timer = *(Timer *)head.next;
+
+			unlink(timer);
+			_count--;
+
+			timer.expired();
+		}
+	}
+}
+
+void EntityWakeupTimer::expired()
+{
+	sys.scheduler().set_entity_state(*_entity, SchedulingEntityState::RUNNABLE);
+}
+
+void sleep_entity(SchedulingEntity& entity, EntityWakeupTimer& timer, uint64_t deadline_ns)
+{
+	UniqueIRQLock l;
+
+	timer.bind(entity);
+	sleepers.insert(timer, deadline_ns);
+
+	sys.scheduler().set_entity_state(entity, SchedulingEntityState::SLEEPING);
+}
+
+void wake_entity(EntityWakeupTimer& timer)
+{
+	UniqueIRQLock l;
+
+	if (!timer.armed()) return;
+
+	sleepers.cancel(timer);
+	timer.expired();
+}
+
+void cancel_sleep(EntityWakeupTimer& timer)
+{
+	UniqueIRQLock l;
+	sleepers.cancel(timer);
+}
+
+void advance_sleepers(uint64_t now_ns)
+{
+	sleepers.advance(now_ns);
+}
+
+void start_sleep_clock()
+{
+	sleep_clock = true;
+}
+
+bool sleep_clock_running()
+{
+	return sleep_clock;
+}
@@ -0,0 +1,182 @@
+/*
+ * Hierarchical Timer Wheel
+ *
+ * A timing wheel for sleeping threads and timeouts.  Timers are kept in four
+ * levels of 64 buckets each, with each level covering 64 times the span of the
+ * level below it.  Arming and cancelling a timer is O(1); advancing the wheel
+ * by a tick only touches the bucket that is due, plus an occasional cascade of
+ * one higher-level bucket into the levels below.
+ *
+ * The kernel keeps one wheel of sleeping entities, for timed sleeps and
+ * timeouts (see sleep_entity() below, and thread-sleep.h).  It is advanced
+ * from the CMOS RTC's periodic interrupt, at about 1kHz, so that timeouts fire
+ * whichever scheduling algorithm is active.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <infos/kernel/sched.h>
+
+#define TIMER_WHEEL_LEVELS		4
+#define TIMER_WHEEL_SLOT_BITS	6
+#define TIMER_WHEEL_SLOTS		(1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_SLOT_MASK	(TIMER_WHEEL_SLOTS - 1)
+
+/**
+ * The intrusive list link used by the buckets of the timer wheel.
+ */
+struct TimerLink
+{
+	TimerLink *next, *prev;
+};
+
+/**
+ * A timer that can be armed on a timer wheel.  Subclasses implement expired(),
+ * which is called (with interrupts disabled) when the timer fires.
+ */
+class Timer : private TimerLink
+{
+	friend class TimerWheel;
+
+public:
+	Timer() : _expires(0)
+	{
+		next = prev = NULL;
+	}
+
+	virtual ~Timer() { }
+
+	/**
+	 * Returns TRUE if the timer is currently armed on a timer wheel.
+	 */
+	bool armed() const { return next != NULL; }
+
+	/**
+	 * Called when the timer expires.
+	 */
+	virtual void expired() = 0;
+
+private:
+	uint64_t _expires;		// The tick at which the timer expires
+};
+
+/**
+ * A hierarchical timing wheel.
+ */
+class TimerWheel
+{
+public:
+	/**
+	 * Constructs a new timer wheel.
+	 * @param resolution_ns The length of one wheel tick, in nanoseconds.  Deadlines
+	 * are rounded up to the next tick.
+	 */
+	TimerWheel(uint64_t resolution_ns);
+
+	/**
+	 * Arms a timer to expire at the given deadline.  If the timer is already armed,
+	 * it is re-armed with the new deadline.
+	 * @param timer The timer to arm.
+	 * @param deadline_ns The absolute time (in nanoseconds of system runtime) at which
+	 * the timer should expire.
+	 */
+	void insert(Timer& timer, uint64_t deadline_ns);
+
+	/**
+	 * Disarms a timer.  Does nothing if the timer is not armed.
+	 * @param timer The timer to disarm.
+	 */
+	void cancel(Timer& timer);
+
+	/**
+	 * Advances the wheel to the given time, firing every timer whose deadline has passed.
+	 * @param now_ns The current system runtime, in nanoseconds.
+	 */
+	void advance(uint64_t now_ns);
+
+	/**
+	 * Returns the number of armed timers.
+	 */
+	unsigned int count() const { return _count; }
+
+private:
+	void enqueue(Timer& timer);
+	unsigned int cascade(unsigned int level);
+
+	static void link(TimerLink& head, TimerLink& entry);
+	static void unlink(TimerLink& entry);
+
+	uint64_t _resolution_ns;
+	uint64_t _current;		// The next tick to be processed
+	unsigned int _count;
+
+	TimerLink _buckets[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+/**
+ * A timer that makes a parked scheduling entity runnable again when it expires.
+ * The entity is woken through the scheduler core (and so returned to the active
+ * algorithm's runqueue by it), so that the core's view of the entity's state
+ * stays in step with the runqueue.
+ */
+class EntityWakeupTimer : public Timer
+{
+public:
+	EntityWakeupTimer() : _entity(NULL) { }
+
+	/**
+	 * Sets the entity that the timer wakes up.
+	 */
+	void bind(infos::kernel::SchedulingEntity& entity)
+	{
+		_entity = &entity;
+	}
+
+	void expired() override;
+
+private:
+	infos::kernel::SchedulingEntity *_entity;
+};
+
+/**
+ * Parks a scheduling entity until the given deadline.  The entity is put to sleep
+ * through the scheduler core, which removes it from the runqueue, and is made runnable
+ * again once the deadline has passed, unless it is woken (or its timer is cancelled)
+ * first.
+ * @param entity The entity to put to sleep.
+ * @param timer The timer used to wake the entity, which must remain valid until it fires
+ * or is cancelled.
+ * @param deadline_ns The system runtime, in nanoseconds, at which to wake the entity.
+ */
+extern void sleep_entity(infos::kernel::SchedulingEntity& entity, EntityWakeupTimer& timer, uint64_t deadline_ns);
+
+/**
+ * Wakes a parked scheduling entity before its deadline.  Does nothing if the timer has
+ * already fired.
+ * @param timer The timer that the entity was parked with.
+ */
+extern void wake_entity(EntityWakeupTimer& timer);
+
+/**
+ * Disarms the timer of an entity that has been woken by other means, without waking it.
+ * @param timer The timer that the entity was parked with.
+ */
+extern void cancel_sleep(EntityWakeupTimer& timer);
+
+/**
+ * Wakes every parked entity whose deadline has passed.  Called from the interrupt
+ * that drives the wheel.
+ * @param now_ns The current system runtime, in nanoseconds.
+ */
+extern void advance_sleepers(uint64_t now_ns);
+
+/**
+ * Records that an interrupt now calls advance_sleepers() periodically.  Until then,
+ * deadlines would never pass, so timed sleeps are refused.
+ */
+extern void start_sleep_clock();
+
+/**
+ * Returns TRUE once something is advancing the wheel of sleeping entities.
+ */
+extern bool sleep_clock_running();
@@ -0,0 +1,17 @@
+/*
+ * Time-stamp Counter
+ */
+#pragma once
+
+#include <infos/define.h>
+
+/**
+ * Reads the processor's time-stamp counter.
+ * @return Returns the current value of the TSC, in cycles.
+ */
+static inline uint64_t read_tsc()
+{
+	uint32_t lo, hi;
+	asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
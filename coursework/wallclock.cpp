@@ -0,0 +1,197 @@
+/*
+ * TSC-based Wall Clock
+ */
+#include <infos/kernel/kernel.h>
+#include <infos/util/lock.h>
+
+#include "boot-trace.h"
+#include "wallclock.h"
+#include "tsc.h"
+
+using namespace infos::kernel;
+using namespace infos::drivers::timer;
+using namespace infos::util;
+
+#define NSEC_PER_SEC	1000000000ull
+
+// Once the calibration window reaches this many seconds, the frequency is only
+// recomputed every this many seconds.
+#define CALIBRATION_INTERVAL	64
+
+WallClock wallclock;
+
+WallClock::WallClock()
+	: _seq(0), _page(NULL), _tsc_hz(0), _ns_per_cycle(0),
+	_mono_base_ns(0), _mono_base_tsc(0),
+	_real_base_ns(0), _real_base_mono_ns(0),
+	_cal_start_tsc(0), _cal_seconds(0)
+{
+}
+
+uint64_t WallClock::monotonic_ns_locked(uint64_t tsc) const
+{
+	// Until the TSC has been calibrated, fall back to the kernel's tick-based runtime.
+	if (!_tsc_hz) return sys.runtime().count();
+
+	return _mono_base_ns + cycles_to_ns(tsc - _mono_base_tsc);
+}
+
+/**
+ * Copies the clock's parameters into the shared time page, if there is one, using the
+ * page's own sequence counter.
+ */
+void WallClock::publish_locked()
+{
+	if (!_page) return;
+
+	_page->seq++;
+	asm volatile("" ::: "memory");
+
+	_page->tsc_hz = _tsc_hz;
+	_page->ns_per_cycle = _ns_per_cycle;
+	_page->mono_base_ns = _mono_base_ns;
+	_page->mono_base_tsc = _mono_base_tsc;
+	_page->real_base_ns = _real_base_ns;
+	_page->real_base_mono_ns = _real_base_mono_ns;
+
+	asm volatile("" ::: "memory");
+	_page->seq++;
+}
+
+void WallClock::publish(TimePageData *page)
+{
+	UniqueIRQLock l;
+
+	write_begin();
+	_page = page;
+	write_end();
+}
+
+void WallClock::synchronise(const RTCTimePoint& tp, uint64_t tsc)
+{
+	uint64_t real_ns = timepoint_to_unix(tp) * NSEC_PER_SEC;
+
+	UniqueIRQLock l;
+
+	write_begin();
+	_real_base_mono_ns = monotonic_ns_locked(tsc);
+	_real_base_ns = real_ns;
+	write_end();
+}
+
+void WallClock::second_elapsed(uint64_t tsc)
+{
+	UniqueIRQLock l;
+
+	// The first interrupt opens the calibration window.
+	if (_cal_start_tsc == 0) {
+		_cal_start_tsc = tsc;
+		_cal_seconds = 0;
+		return;
+	}
+
+	_cal_seconds++;
+
+	// Recalibrate after 1, 2, 4, ... seconds, and then at every calibration interval, so
+	// that a usable frequency is available quickly and then becomes more precise.
+	bool power_of_two = (_cal_seconds & (_cal_seconds - 1)) == 0;
+	if (!power_of_two && (_cal_seconds % CALIBRATION_INTERVAL) != 0) return;
+
+	calibrate((tsc - _cal_start_tsc) / _cal_seconds, tsc);
+}
+
+void WallClock::calibrate(uint64_t hz, uint64_t tsc)
+{
+	if (hz == 0) return;
+
+	UniqueIRQLock l;
+
+	if (!_tsc_hz) boot_trace("wallclock.calibrated");
+
+	write_begin();
+
+	// Rebase the monotonic clock at the current instant, so that a change in frequency
+	// never makes it jump.
+	_mono_base_ns = monotonic_ns_locked(tsc);
+	_mono_base_tsc = tsc;
+
+	_tsc_hz = hz;
+	_ns_per_cycle = (NSEC_PER_SEC << 32) / hz;
+
+	write_end();
+}
+
+uint64_t WallClock::monotonic_ns() const
+{
+	uint64_t seq, ns;
+
+	do {
+		seq = read_begin();
+		ns = monotonic_ns_locked(read_tsc());
+	} while (read_retry(seq));
+
+	return ns;
+}
+
+uint64_t WallClock::realtime_ns() const
+{
+	uint64_t seq, ns;
+
+	do {
+		seq = read_begin();
+		ns = _real_base_ns + (monotonic_ns_locked(read_tsc()) - _real_base_mono_ns);
+	} while (read_retry(seq));
+
+	return ns;
+}
+
+void WallClock::read_timepoint(RTCTimePoint& tp) const
+{
+	unix_to_timepoint(realtime_ns() / NSEC_PER_SEC, tp);
+}
+
+/*
+ * The calendar conversions use the days-from-civil algorithm, counting in
+ * 400-year eras of 146097 days, with years starting on the 1st of March so
+ * that the leap day falls at the end of the year.
+ */
+
+uint64_t WallClock::timepoint_to_unix(const RTCTimePoint& tp)
+{
+	uint64_t year = 2000 + tp.year;
+	uint64_t month = tp.month;
+
+	if (month <= 2) year--;
+
+	uint64_t era = year / 400;
+	uint64_t year_of_era = year - era * 400;
+	uint64_t day_of_year = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + tp.day_of_month - 1;
+	uint64_t day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+	uint64_t days = era * 146097 + day_of_era - 719468;
+
+	return days * 86400 + tp.hours * 3600 + tp.minutes * 60 + tp.seconds;
+}
+
+void WallClock::unix_to_timepoint(uint64_t seconds, RTCTimePoint& tp)
+{
+	uint64_t days = seconds / 86400;
+	uint64_t secs = seconds % 86400;
+
+	tp.hours = secs / 3600;
+	tp.minutes = (secs / 60) % 60;
+	tp.seconds = secs % 60;
+
+	days += 719468;
+
+	uint64_t era = days / 146097;
+	uint64_t day_of_era = days - era * 146097;
+	uint64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	uint64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	uint64_t mp = (5 * day_of_year + 2) / 153;
+	uint64_t month = mp < 10 ? mp + 3 : mp - 9;
+	uint64_t year = year_of_era + era * 400 + (month <= 2);
+
+	tp.day_of_month = day_of_year - (153 * mp + 2) / 5 + 1;
+	tp.month = month;
+	tp.year = year - 2000;
+}
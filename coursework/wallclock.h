@@ -0,0 +1,138 @@
+/*
+ * TSC-based Wall Clock
+ *
+ * Keeps the time of day without port I/O.  The CMOS RTC is read once at boot,
+ * and again at a periodic resync; in between, time is extrapolated from the
+ * TSC, whose frequency is calibrated against the RTC's once-a-second
+ * update-ended interrupt.  Reading the time is a handful of arithmetic
+ * operations, protected by a sequence counter so that readers never block
+ * the interrupt handler that updates the clock.  The clock is also updated
+ * from thread context (e.g. by calibrate()), so every writer disables
+ * interrupts for its update; writers never interleave.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <infos/drivers/timer/rtc.h>
+
+#include "time-page-abi.h"
+
+class WallClock
+{
+public:
+	WallClock();
+
+	/**
+	 * Sets the wall-clock time.
+	 * @param tp The time read from the RTC.
+	 * @param tsc The TSC value at the instant the time applies to.
+	 */
+	void synchronise(const infos::drivers::timer::RTCTimePoint& tp, uint64_t tsc);
+
+	/**
+	 * Called on every RTC update-ended interrupt, i.e. exactly on each second boundary.
+	 * Used to calibrate the TSC frequency.
+	 * @param tsc The TSC value at the interrupt.
+	 */
+	void second_elapsed(uint64_t tsc);
+
+	/**
+	 * Sets the TSC frequency from an external calibration, e.g. against the PIT, so that
+	 * the clock can be used before the RTC has calibrated it.  The RTC calibration still
+	 * refines the frequency as it accumulates.
+	 * @param hz The TSC frequency, in Hz.
+	 * @param tsc The current TSC value.
+	 */
+	void calibrate(uint64_t hz, uint64_t tsc);
+
+	/**
+	 * Publishes the clock's parameters into a shared time page, which is kept up to date
+	 * from then on, so that user processes can compute the time themselves.
+	 * @param page The kernel mapping of the shared time page.
+	 */
+	void publish(TimePageData *page);
+
+	/**
+	 * Returns TRUE if the TSC frequency has been calibrated, and the clock can be read
+	 * without consulting the RTC.
+	 */
+	bool calibrated() const { return _tsc_hz != 0; }
+
+	/**
+	 * Returns the calibrated TSC frequency, in Hz, or zero if it is not yet known.
+	 */
+	uint64_t tsc_hz() const { return _tsc_hz; }
+
+	/**
+	 * Returns the number of nanoseconds since boot.  This never goes backwards, even
+	 * when the clock is resynchronised with the RTC.
+	 */
+	uint64_t monotonic_ns() const;
+
+	/**
+	 * Returns the wall-clock time, as nanoseconds since the Unix epoch.
+	 */
+	uint64_t realtime_ns() const;
+
+	/**
+	 * Populates a time point with the current wall-clock time.
+	 */
+	void read_timepoint(infos::drivers::timer::RTCTimePoint& tp) const;
+
+	/**
+	 * Converts a time point to seconds since the Unix epoch.  The two-digit RTC year is
+	 * taken to be in the 21st century.
+	 */
+	static uint64_t timepoint_to_unix(const infos::drivers::timer::RTCTimePoint& tp);
+
+	/**
+	 * Converts seconds since the Unix epoch to a time point.
+	 */
+	static void unix_to_timepoint(uint64_t seconds, infos::drivers::timer::RTCTimePoint& tp);
+
+private:
+	void write_begin() { _seq++; asm volatile("" ::: "memory"); }
+	void write_end() { publish_locked(); asm volatile("" ::: "memory"); _seq++; }
+
+	uint64_t read_begin() const
+	{
+		uint64_t seq;
+		do {
+			seq = *(volatile uint64_t *)&_seq;
+		} while (seq & 1);
+
+		asm volatile("" ::: "memory");
+		return seq;
+	}
+
+	bool read_retry(uint64_t seq) const
+	{
+		asm volatile("" ::: "memory");
+		return *(volatile uint64_t *)&_seq != seq;
+	}
+
+	uint64_t cycles_to_ns(uint64_t cycles) const
+	{
+		return (uint64_t)(((unsigned __int128)cycles * _ns_per_cycle) >> 32);
+	}
+
+	uint64_t monotonic_ns_locked(uint64_t tsc) const;
+	void publish_locked();
+
+	uint64_t _seq;
+	TimePageData *_page;
+
+	uint64_t _tsc_hz;
+	uint64_t _ns_per_cycle;		// Nanoseconds per TSC cycle, as a 32.32 fixed-point number
+
+	uint64_t _mono_base_ns, _mono_base_tsc;
+	uint64_t _real_base_ns, _real_base_mono_ns;
+
+	uint64_t _cal_start_tsc;
+	uint64_t _cal_seconds;
+};
+
+/**
+ * The system wall clock.
+ */
+extern WallClock wallclock;
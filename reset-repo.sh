@@ -2,6 +2,7 @@
 
 TOPDIR=`pwd`
 CWKDIR=$TOPDIR/coursework
+CWKUSERDIR=$TOPDIR/coursework-user
 INFOS_REPO=$TOPDIR/infos
 INFOS_USER_REPO=$TOPDIR/infos-user
 
@@ -40,6 +41,13 @@ echo
 echo "Restoring coursework link..."
 ln -s $CWKDIR $INFOS_REPO/oot
 
+echo
+echo "Restoring coursework user-space links..."
+ln -s $CWKDIR/time-page-abi.h $INFOS_USER_REPO/include/infos/time-page-abi.h
+for f in $CWKUSERDIR/include/infos/*.h; do ln -s $f $INFOS_USER_REPO/include/infos/; done
+for f in $CWKUSERDIR/lib/*.cpp; do ln -s $f $INFOS_USER_REPO/lib/; done
+for d in $CWKUSERDIR/src/*; do ln -s $d $INFOS_USER_REPO/src/; done
+
 echo
 echo "DONE"
 echo
@@ -0,0 +1,22 @@
+#!/bin/sh
+
+TOP=`pwd`
+CWKDIR=$TOP/coursework
+SIM_DIR=$TOP/tools/sched-sim
+OUT_DIR=$SIM_DIR/out
+
+# Bind the round-robin scheduler at compile time, if asked to (see
+# coursework/static-algorithms.h).
+DEFINES=-DINFOS_SCHED_SIM
+case " $STATIC_ALGORITHMS " in
+  *" rr "*) DEFINES="$DEFINES -DINFOS_STATIC_SCHED_RR" ;;
+esac
+
+echo "Building scheduler simulator..."
+
+mkdir -p $OUT_DIR
+g++ -std=gnu++17 -O2 -Wall $DEFINES -I$SIM_DIR/include -o $OUT_DIR/sched-sim \
+	$SIM_DIR/sim.cpp $SIM_DIR/cfs.cpp $CWKDIR/sched-rr.cpp $CWKDIR/sched-stats.cpp \
+	$CWKDIR/timer-wheel.cpp $CWKDIR/boot-trace.cpp $CWKDIR/wallclock.cpp || exit 1
+
+$OUT_DIR/sched-sim $*
@@ -0,0 +1,73 @@
+/*
+ * Scheduler Simulator
+ * Completely Fair Scheduler
+ *
+ * A copy of the kernel's CFS algorithm (kernel/sched-cfs.cpp in the InfOS tree),
+ * so that the round-robin scheduler can be compared against it on the host.  The
+ * simulator core charges CPU time to the running entity, just as the kernel's
+ * scheduler core does, and the entity with the least CPU time is picked next.
+ */
+#include <infos/kernel/sched.h>
+#include <infos/kernel/thread.h>
+#include <infos/util/list.h>
+#include <infos/util/lock.h>
+
+#include "../../coursework/sched-stats.h"
+
+using namespace infos::kernel;
+using namespace infos::util;
+
+class CFSScheduler : public SchedulingAlgorithm
+{
+public:
+	CFSScheduler() : stats("cfs") { }
+
+	const char* name() const override { return "cfs"; }
+
+	void add_to_runqueue(SchedulingEntity& entity) override
+	{
+		UniqueIRQLock l;
+		runqueue.enqueue(&entity);
+		stats.entity_woken(entity);
+	}
+
+	void add_to_runqueue_batch(const List<SchedulingEntity *>& entities) override
+	{
+		UniqueIRQLock l;
+
+		for (const auto& entity : entities) {
+			runqueue.enqueue(entity);
+			stats.entity_woken(*entity);
+		}
+	}
+
+	void remove_from_runqueue(SchedulingEntity& entity) override
+	{
+		UniqueIRQLock l;
+		runqueue.remove(&entity);
+		stats.entity_blocked(entity);
+	}
+
+	SchedulingEntity *pick_next_entity() override
+	{
+		UniqueIRQLock l;
+		SchedStatsTimer timer(stats);
+
+		SchedulingEntity *min_runtime_entity = NULL;
+
+		for (const auto& entity : runqueue) {
+			if (min_runtime_entity == NULL || entity->cpu_runtime() < min_runtime_entity->cpu_runtime()) {
+				min_runtime_entity = entity;
+			}
+		}
+
+		stats.entity_picked(min_runtime_entity, runqueue.count());
+		return min_runtime_entity;
+	}
+
+private:
+	List<SchedulingEntity *> runqueue;
+	SchedStats stats;
+};
+
+RegisterScheduler(CFSScheduler);
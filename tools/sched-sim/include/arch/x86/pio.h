@@ -0,0 +1,17 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <arch/x86/pio.h>.  There are no ports to talk to, so
+ * writes are discarded and reads return all ones.
+ */
+#pragma once
+
+#include <infos/define.h>
+
+namespace infos {
+	namespace arch {
+		namespace x86 {
+			static inline void __outb(uint16_t port, uint8_t value) { }
+			static inline uint8_t __inb(uint16_t port) { return 0xFF; }
+		}
+	}
+}
@@ -0,0 +1,12 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/define.h>.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdarg>
+#include <cassert>
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
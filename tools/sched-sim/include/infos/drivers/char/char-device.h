@@ -0,0 +1,58 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/drivers/char/char-device.h>.  RegisterDevice adds
+ * the device to the simulator's registry, so its output can be read back.
+ */
+#pragma once
+
+#include <infos/define.h>
+
+namespace infos {
+	namespace drivers {
+		class DeviceClass
+		{
+		public:
+			DeviceClass(const DeviceClass& parent, const char *name) : _parent(&parent), _name(name) { }
+			DeviceClass(const char *name) : _parent(NULL), _name(name) { }
+
+			const char *name() const { return _name; }
+
+		private:
+			const DeviceClass *_parent;
+			const char *_name;
+		};
+
+		class DeviceManager { };
+
+		class Device
+		{
+		public:
+			virtual ~Device() { }
+			virtual const DeviceClass& device_class() const = 0;
+
+			// The simulator never initialises devices.
+			virtual bool init(DeviceManager& dm) { return true; }
+		};
+
+		class CharacterDevice : public Device
+		{
+		public:
+			static const DeviceClass CharacterDeviceClass;
+
+			virtual int read(void *buffer, size_t size) = 0;
+			virtual int write(const void *buffer, size_t size) = 0;
+		};
+
+		/**
+		 * Adds a device to the simulator's registry.
+		 */
+		struct DeviceRegistration
+		{
+			DeviceRegistration(Device& device);
+		};
+	}
+}
+
+#define RegisterDevice(_class) \
+	static _class __device_##_class; \
+	static infos::drivers::DeviceRegistration __device_reg_##_class(__device_##_class)
@@ -0,0 +1,17 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/drivers/timer/rtc.h>, for the wall clock that the
+ * boot trace reads its timebase from.
+ */
+#pragma once
+
+namespace infos {
+	namespace drivers {
+		namespace timer {
+			struct RTCTimePoint
+			{
+				unsigned short seconds, minutes, hours, day_of_month, month, year;
+			};
+		}
+	}
+}
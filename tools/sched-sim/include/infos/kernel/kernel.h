@@ -0,0 +1,44 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/kernel/kernel.h>.  The kernel's runtime is the
+ * simulated clock, which only moves when the simulator advances it.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <infos/kernel/process.h>
+#include <infos/kernel/sched.h>
+
+namespace infos {
+	namespace kernel {
+		class Nanoseconds
+		{
+		public:
+			Nanoseconds(uint64_t count) : _count(count) { }
+			uint64_t count() const { return _count; }
+
+		private:
+			uint64_t _count;
+		};
+
+		class Kernel
+		{
+		public:
+			Kernel() : _runtime(0) { }
+
+			Nanoseconds runtime() const { return Nanoseconds(_runtime); }
+			void advance(uint64_t delta) { _runtime += delta; }
+			void reset() { _runtime = 0; }
+
+			Scheduler& scheduler() { return _scheduler; }
+			Process& kernel_process() { return _kernel_process; }
+
+		private:
+			uint64_t _runtime;
+			Scheduler _scheduler;
+			Process _kernel_process;
+		};
+
+		extern Kernel sys;
+	}
+}
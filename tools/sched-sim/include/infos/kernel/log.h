@@ -0,0 +1,24 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/kernel/log.h>.  Kernel log messages are discarded;
+ * the simulator prints its own report.
+ */
+#pragma once
+
+#include <infos/define.h>
+
+namespace infos {
+	namespace kernel {
+		namespace LogLevel {
+			enum LogLevel { DEBUG, INFO, IMPORTANT, WARNING, ERROR, FATAL };
+		}
+
+		class Log
+		{
+		public:
+			void messagef(LogLevel::LogLevel level, const char *fmt, ...) { }
+		};
+
+		inline Log syslog;
+	}
+}
@@ -0,0 +1,21 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/kernel/process.h>.  Threads cannot be created, so
+ * kernel code that starts a thread takes its failure path.
+ */
+#pragma once
+
+#include <infos/kernel/thread.h>
+
+namespace infos {
+	namespace kernel {
+		class Process
+		{
+		public:
+			Thread *create_thread(ThreadPrivilege::ThreadPrivilege privilege, Thread::thread_proc_t proc, const char *name)
+			{
+				return NULL;
+			}
+		};
+	}
+}
@@ -0,0 +1,44 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/kernel/sched-entity.h>.
+ */
+#pragma once
+
+#include <infos/define.h>
+
+namespace infos {
+	namespace kernel {
+		namespace SchedulingEntityState {
+			enum SchedulingEntityState {
+				STOPPED,
+				RUNNABLE,
+				RUNNING,
+				SLEEPING
+			};
+		}
+
+		class SchedulingEntity
+		{
+			friend class Scheduler;
+
+		public:
+			typedef uint64_t EntityRuntime;
+
+			SchedulingEntity() : _cpu_runtime(0), _exec_start_time(0), _state(SchedulingEntityState::STOPPED) { }
+			virtual ~SchedulingEntity() { }
+
+			SchedulingEntityState::SchedulingEntityState state() const { return _state; }
+
+			EntityRuntime cpu_runtime() const { return _cpu_runtime; }
+			void increment_cpu_runtime(EntityRuntime delta) { _cpu_runtime += delta; }
+
+			EntityRuntime exec_start_time() const { return _exec_start_time; }
+			void update_exec_start_time(EntityRuntime time) { _exec_start_time = time; }
+
+		private:
+			EntityRuntime _cpu_runtime;
+			EntityRuntime _exec_start_time;
+			SchedulingEntityState::SchedulingEntityState _state;
+		};
+	}
+}
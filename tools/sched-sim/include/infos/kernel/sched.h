@@ -0,0 +1,98 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/kernel/sched.h>.  RegisterScheduler adds the algorithm
+ * to the simulator's registry instead of the kernel's .schedalgs section.
+ */
+#pragma once
+
+#include <infos/kernel/sched-entity.h>
+#include <infos/util/list.h>
+
+namespace infos {
+	namespace kernel {
+		class SchedulingAlgorithm
+		{
+		public:
+			virtual ~SchedulingAlgorithm() { }
+
+			virtual const char *name() const = 0;
+
+			virtual void init() { }
+
+			virtual void add_to_runqueue(SchedulingEntity& entity) = 0;
+			virtual void remove_from_runqueue(SchedulingEntity& entity) = 0;
+			virtual SchedulingEntity *pick_next_entity() = 0;
+
+			/*
+			 * SIMULATOR ONLY -- everything above mirrors the kernel's SchedulingAlgorithm;
+			 * nothing below exists in the kernel's header, and the kernel's scheduler core
+			 * never calls it.
+			 */
+
+			/**
+			 * Adds a group of entities to the runqueue at once.  Algorithms that can take
+			 * their runqueue lock once for the whole group override this.  Only the
+			 * simulator's barrier workload calls it, so its results measure this proposed
+			 * hook, not anything the kernel does today.
+			 */
+			virtual void add_to_runqueue_batch(const util::List<SchedulingEntity *>& entities)
+			{
+				for (const auto& entity : entities) {
+					add_to_runqueue(*entity);
+				}
+			}
+		};
+
+		/**
+		 * The scheduler core.  Moving an entity into or out of a runnable state adds it to,
+		 * or removes it from, the active algorithm's runqueue.  The simulator drives the
+		 * algorithm directly, so only code under test (e.g. a wakeup timer) comes through
+		 * here.
+		 */
+		class Scheduler
+		{
+		public:
+			Scheduler() : _algorithm(NULL) { }
+
+			void set_active_algorithm(SchedulingAlgorithm& algorithm)
+			{
+				_algorithm = &algorithm;
+				_algorithm->init();
+			}
+
+			void set_entity_state(SchedulingEntity& entity, SchedulingEntityState::SchedulingEntityState state)
+			{
+				bool was_runnable = entity._state == SchedulingEntityState::RUNNABLE || entity._state == SchedulingEntityState::RUNNING;
+				bool runnable = state == SchedulingEntityState::RUNNABLE || state == SchedulingEntityState::RUNNING;
+
+				entity._state = state;
+
+				if (!_algorithm) return;
+
+				if (runnable && !was_runnable) {
+					_algorithm->add_to_runqueue(entity);
+				} else if (!runnable && was_runnable) {
+					_algorithm->remove_from_runqueue(entity);
+				}
+			}
+
+			// The simulator drives scheduling itself.
+			void schedule() { }
+
+		private:
+			SchedulingAlgorithm *_algorithm;
+		};
+
+		/**
+		 * Adds a scheduling algorithm to the simulator's registry.
+		 */
+		struct SchedulerRegistration
+		{
+			SchedulerRegistration(SchedulingAlgorithm& algorithm);
+		};
+	}
+}
+
+#define RegisterScheduler(_class) \
+	static _class __sched_alg_##_class; \
+	static infos::kernel::SchedulerRegistration __sched_reg_##_class(__sched_alg_##_class)
@@ -0,0 +1,30 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/kernel/thread.h>.  The simulator has no kernel
+ * threads of its own; the current thread is a placeholder.
+ */
+#pragma once
+
+#include <infos/kernel/sched-entity.h>
+
+namespace infos {
+	namespace kernel {
+		namespace ThreadPrivilege {
+			enum ThreadPrivilege { User, Kernel };
+		}
+
+		class Thread : public SchedulingEntity
+		{
+		public:
+			typedef void (*thread_proc_t)(void *);
+
+			static Thread& current()
+			{
+				static Thread placeholder;
+				return placeholder;
+			}
+
+			void start(unsigned long arg) { }
+		};
+	}
+}
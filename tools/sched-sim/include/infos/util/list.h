@@ -0,0 +1,115 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/util/list.h>.  Mirrors the kernel's singly-linked
+ * list, so that runqueue operations have the same cost characteristics.
+ */
+#pragma once
+
+#include <infos/define.h>
+
+namespace infos {
+	namespace util {
+		template<typename T>
+		class List
+		{
+			struct Node {
+				T value;
+				Node *next;
+			};
+
+		public:
+			class Iterator
+			{
+			public:
+				Iterator(Node *node) : _node(node) { }
+
+				T& operator*() const { return _node->value; }
+				Iterator& operator++() { _node = _node->next; return *this; }
+				bool operator!=(const Iterator& other) const { return _node != other._node; }
+
+			private:
+				Node *_node;
+			};
+
+			List() : _head(NULL), _tail(NULL), _count(0) { }
+			~List() { clear(); }
+
+			void append(T const& value)
+			{
+				Node *node = new Node { value, NULL };
+
+				if (_tail) _tail->next = node;
+				else _head = node;
+
+				_tail = node;
+				_count++;
+			}
+
+			void push(T const& value)
+			{
+				Node *node = new Node { value, _head };
+
+				_head = node;
+				if (!_tail) _tail = node;
+				_count++;
+			}
+
+			T pop()
+			{
+				Node *node = _head;
+				T value = node->value;
+
+				_head = node->next;
+				if (!_head) _tail = NULL;
+				_count--;
+
+				delete node;
+				return value;
+			}
+
+			void enqueue(T const& value) { append(value); }
+			T dequeue() { return pop(); }
+
+			void remove(T const& value)
+			{
+				Node *prev = NULL, *node = _head;
+
+				while (node) {
+					Node *next = node->next;
+
+					if (node->value == value) {
+						if (prev) prev->next = next;
+						else _head = next;
+
+						if (_tail == node) _tail = prev;
+						_count--;
+
+						delete node;
+					} else {
+						prev = node;
+					}
+
+					node = next;
+				}
+			}
+
+			void clear()
+			{
+				while (_head) pop();
+			}
+
+			T const& first() const { return _head->value; }
+			T const& last() const { return _tail->value; }
+
+			unsigned int count() const { return _count; }
+			bool empty() const { return _count == 0; }
+
+			Iterator begin() const { return Iterator(_head); }
+			Iterator end() const { return Iterator(NULL); }
+
+		private:
+			Node *_head, *_tail;
+			unsigned int _count;
+		};
+	}
+}
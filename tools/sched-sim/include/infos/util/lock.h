@@ -0,0 +1,28 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/util/lock.h>.  The simulator is single-threaded, so
+ * taking the IRQ lock only counts the acquisition, and mutexes do nothing.
+ */
+#pragma once
+
+namespace infos {
+	namespace util {
+		class UniqueIRQLock
+		{
+		public:
+			UniqueIRQLock() { acquisitions++; }
+			~UniqueIRQLock() { }
+
+			static inline unsigned long acquisitions;
+		};
+
+		class Mutex { };
+
+		template<typename T>
+		class UniqueLock
+		{
+		public:
+			UniqueLock(T& lock) { }
+		};
+	}
+}
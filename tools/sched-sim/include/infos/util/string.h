@@ -0,0 +1,8 @@
+/*
+ * Scheduler Simulator
+ * Host stand-in for <infos/util/string.h>.
+ */
+#pragma once
+
+#include <infos/define.h>
+#include <cstring>
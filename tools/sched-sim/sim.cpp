@@ -0,0 +1,533 @@
+/*
+ * Scheduler Simulator
+ *
+ * Drives the kernel's scheduling algorithms with synthetic workloads on a
+ * simulated clock.  The simulated CPU runs the picked entity until the next
+ * timer tick, or until its CPU burst ends and it blocks.  Wakeups are delivered
+ * at their due time, but (as in the kernel) only take effect at the next
+ * scheduling event.
+ */
+#include <infos/kernel/sched.h>
+#include <infos/kernel/kernel.h>
+#include <infos/drivers/char/char-device.h>
+#include <infos/util/list.h>
+#include <infos/util/lock.h>
+
+#include "../../coursework/sched-stats.h"
+#include "../../coursework/static-algorithms.h"
+#include "../../coursework/timer-wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+using namespace infos::kernel;
+using namespace infos::drivers;
+using namespace infos::util;
+
+Kernel infos::kernel::sys;
+const DeviceClass CharacterDevice::CharacterDeviceClass("char");
+
+/*
+ * The registries are function-local, because the algorithms and devices register
+ * themselves from static constructors in other translation units.
+ */
+static std::vector<SchedulingAlgorithm *>& algorithms()
+{
+	static std::vector<SchedulingAlgorithm *> registry;
+	return registry;
+}
+
+static std::vector<Device *>& devices()
+{
+	static std::vector<Device *> registry;
+	return registry;
+}
+
+SchedulerRegistration::SchedulerRegistration(SchedulingAlgorithm& algorithm)
+{
+	algorithms().push_back(&algorithm);
+}
+
+DeviceRegistration::DeviceRegistration(Device& device)
+{
+	devices().push_back(&device);
+}
+
+/**
+ * Deterministic pseudo-random numbers, so that every algorithm sees the same workload.
+ */
+class Random
+{
+public:
+	Random(uint64_t seed) : _state(seed) { }
+
+	uint64_t next()
+	{
+		_state = _state * 6364136223846793005ull + 1442695040888963407ull;
+		return _state >> 33;
+	}
+
+	uint64_t range(uint64_t lo, uint64_t hi)
+	{
+		return lo + next() % (hi - lo + 1);
+	}
+
+private:
+	uint64_t _state;
+};
+
+/**
+ * The behaviour of one class of simulated thread: it runs for a CPU burst, then
+ * blocks for a while, forever.  A zero block time means the thread never blocks.
+ * Threads in a barrier class instead wait until every thread in the class has
+ * finished its burst, and are then released together after the block time,
+ * through the simulator-only add_to_runqueue_batch hook.
+ */
+struct ThreadClass
+{
+	const char *name;
+	unsigned int count;
+	uint64_t min_burst_ns, max_burst_ns;
+	uint64_t min_block_ns, max_block_ns;
+	bool barrier;
+};
+
+struct Workload
+{
+	const char *name;
+	std::vector<ThreadClass> classes;
+};
+
+static const uint64_t US = 1000;
+static const uint64_t MS = 1000 * US;
+
+static std::vector<Workload> workloads = {
+	{ "cpu", {
+		{ "cpu", 8, 0, 0, 0, 0 },
+	} },
+	{ "io", {
+		{ "io", 64, 20 * US, 100 * US, 500 * US, 2 * MS },
+	} },
+	{ "bursty", {
+		{ "bursty", 32, 100 * US, 5 * MS, 0, 20 * MS },
+	} },
+	{ "mixed", {
+		{ "cpu", 4, 0, 0, 0, 0 },
+		{ "io", 32, 20 * US, 100 * US, 500 * US, 2 * MS },
+	} },
+	{ "many", {
+		{ "cpu", 16, 0, 0, 0, 0 },
+		{ "io", 2000, 20 * US, 200 * US, 5 * MS, 50 * MS },
+	} },
+	{ "barrier", {
+		{ "barrier", 256, 20 * US, 500 * US, 1 * MS, 1 * MS, true },
+	} },
+};
+
+struct SimThread;
+
+/**
+ * Wakes a sleeping thread from the timer wheel, when the simulator is using one.
+ */
+struct SimSleepTimer : public Timer
+{
+	SimThread *thread;
+	std::function<void(SimThread *)> *wake;
+
+	void expired() override { (*wake)(thread); }
+};
+
+struct SimThread : public SchedulingEntity
+{
+	SimSleepTimer sleep_timer;
+	const ThreadClass *cls;
+	unsigned int cls_index;
+	uint64_t burst_left;
+	uint64_t cpu_received;
+	uint64_t woken_at;
+	bool waiting;
+
+	bool cpu_bound() const { return cls->max_block_ns == 0; }
+};
+
+/**
+ * A pending wakeup.  A barrier release wakes every thread in the class at once.
+ */
+struct Wakeup
+{
+	uint64_t time;
+	SimThread *thread;
+	const ThreadClass *barrier;
+
+	bool operator>(const Wakeup& other) const { return time > other.time; }
+};
+
+struct Options
+{
+	uint64_t duration_ns = 2000 * MS;
+	uint64_t tick_ns = 1 * MS;
+	const char *workload = NULL;
+	const char *algorithm = NULL;
+	bool dump_stats = false;
+	bool timer_wheel = false;
+};
+
+struct Result
+{
+	uint64_t threads;
+	uint64_t picks;
+	uint64_t switches;
+	uint64_t voluntary, involuntary;
+	uint64_t locks;
+	double pick_mean_ns, pick_p99_ns;
+	double wheel_mean_ns;
+	double lat_p50_us, lat_p99_us, lat_max_us;
+	double fairness;
+	double utilisation;
+};
+
+template<typename T>
+static T percentile(std::vector<T>& samples, double pct)
+{
+	if (samples.empty()) return 0;
+
+	size_t index = (size_t)((samples.size() - 1) * pct / 100.0);
+	std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+	return samples[index];
+}
+
+/**
+ * Jain's fairness index of the CPU time received by the threads of each class,
+ * reporting the least fair class.  1.0 is perfectly fair.
+ */
+static double fairness(const std::vector<SimThread *>& threads, size_t nr_classes)
+{
+	double worst = 1.0;
+
+	for (size_t c = 0; c < nr_classes; c++) {
+		double sum = 0, sum_sq = 0;
+		size_t n = 0;
+
+		for (auto thread : threads) {
+			if (thread->cls_index != c) continue;
+
+			double x = thread->cpu_received;
+			sum += x;
+			sum_sq += x * x;
+			n++;
+		}
+
+		if (n > 0 && sum_sq > 0) worst = std::min(worst, (sum * sum) / (n * sum_sq));
+	}
+
+	return worst;
+}
+
+static uint64_t host_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Calls into an algorithm directly, rather than through its virtual interface, when it
+ * is the one bound at compile time (STATIC_ALGORITHMS=rr ./sched-sim.sh), so that the
+ * cost of the virtual calls can be compared.
+ */
+static SchedulingEntity *pick_next_entity(SchedulingAlgorithm& algorithm)
+{
+#ifdef INFOS_STATIC_SCHED
+	if (static_scheduler_is(algorithm)) return static_pick_next_entity();
+#endif
+	return algorithm.pick_next_entity();
+}
+
+static void add_to_runqueue(SchedulingAlgorithm& algorithm, SchedulingEntity& entity)
+{
+#ifdef INFOS_STATIC_SCHED
+	if (static_scheduler_is(algorithm)) return static_add_to_runqueue(entity);
+#endif
+	algorithm.add_to_runqueue(entity);
+}
+
+static void remove_from_runqueue(SchedulingAlgorithm& algorithm, SchedulingEntity& entity)
+{
+#ifdef INFOS_STATIC_SCHED
+	if (static_scheduler_is(algorithm)) return static_remove_from_runqueue(entity);
+#endif
+	algorithm.remove_from_runqueue(entity);
+}
+
+static Result simulate(SchedulingAlgorithm& algorithm, const Workload& workload, const Options& options)
+{
+	Random random(42);
+	std::vector<SimThread *> threads;
+	std::priority_queue<Wakeup, std::vector<Wakeup>, std::greater<Wakeup>> wakeups;
+	std::vector<uint32_t> pick_cost, wheel_cost;
+	TimerWheel wheel(options.tick_ns);
+	std::vector<uint64_t> latency;
+
+	sys.reset();
+	sys.scheduler().set_active_algorithm(algorithm);
+	UniqueIRQLock::acquisitions = 0;
+
+	for (auto stats = 0u; stats < SchedStats::nr_registered(); stats++) {
+		SchedStats::registered(stats)->counters.reset();
+	}
+
+	auto new_burst = [&](SimThread *thread) {
+		thread->burst_left = thread->cpu_bound() ? UINT64_MAX :
+			random.range(thread->cls->min_burst_ns, thread->cls->max_burst_ns);
+	};
+
+	auto prepare_wake = [&](SimThread *thread) {
+		new_burst(thread);
+		thread->woken_at = sys.runtime().count();
+		thread->waiting = true;
+	};
+
+	std::function<void(SimThread *)> wake = [&](SimThread *thread) {
+		prepare_wake(thread);
+		add_to_runqueue(algorithm, *thread);
+	};
+
+	// Threads of each barrier class that are waiting for the rest of the class.
+	std::vector<std::vector<SimThread *>> barriers(workload.classes.size());
+
+	auto release = [&](const ThreadClass *cls) {
+		std::vector<SimThread *>& waiters = barriers[cls - &workload.classes[0]];
+		List<SchedulingEntity *> batch;
+
+		for (auto thread : waiters) {
+			prepare_wake(thread);
+			batch.append(thread);
+		}
+
+		waiters.clear();
+		algorithm.add_to_runqueue_batch(batch);
+	};
+
+	for (size_t c = 0; c < workload.classes.size(); c++) {
+		for (unsigned int i = 0; i < workload.classes[c].count; i++) {
+			SimThread *thread = new SimThread();
+			thread->cls = &workload.classes[c];
+			thread->cls_index = c;
+			thread->cpu_received = 0;
+			thread->sleep_timer.thread = thread;
+			thread->sleep_timer.wake = &wake;
+
+			threads.push_back(thread);
+			wake(thread);
+		}
+	}
+
+	SimThread *current = NULL;
+	uint64_t switches = 0, busy = 0;
+	uint64_t next_tick = options.tick_ns;
+
+	auto pick = [&]() {
+		uint64_t start = host_ns();
+		SimThread *next = (SimThread *)pick_next_entity(algorithm);
+		pick_cost.push_back(host_ns() - start);
+
+		if (next != current) switches++;
+
+		if (next && next->waiting) {
+			latency.push_back(sys.runtime().count() - next->woken_at);
+			next->waiting = false;
+		}
+
+		current = next;
+	};
+
+	pick();
+
+	while (sys.runtime().count() < options.duration_ns) {
+		uint64_t now = sys.runtime().count();
+		uint64_t until = next_tick;
+
+		if (!wakeups.empty()) until = std::min(until, wakeups.top().time);
+		if (current && current->burst_left != UINT64_MAX) until = std::min(until, now + current->burst_left);
+
+		uint64_t delta = until - now;
+		sys.advance(delta);
+
+		if (current) {
+			current->increment_cpu_runtime(delta);
+			current->cpu_received += delta;
+			if (current->burst_left != UINT64_MAX) current->burst_left -= delta;
+			busy += delta;
+		}
+
+		now = sys.runtime().count();
+
+		while (!wakeups.empty() && wakeups.top().time <= now) {
+			Wakeup wakeup = wakeups.top();
+			wakeups.pop();
+
+			if (wakeup.barrier) release(wakeup.barrier);
+			else wake(wakeup.thread);
+		}
+
+		if (current && current->burst_left == 0) {
+			// The running thread has finished its burst, and blocks.
+			const ThreadClass *cls = current->cls;
+			uint64_t wake_at = now + random.range(cls->min_block_ns, cls->max_block_ns);
+
+			remove_from_runqueue(algorithm, *current);
+
+			if (cls->barrier) {
+				std::vector<SimThread *>& waiters = barriers[current->cls_index];
+				waiters.push_back(current);
+
+				if (waiters.size() == cls->count) wakeups.push({ wake_at, NULL, cls });
+			} else if (options.timer_wheel) {
+				wheel.insert(current->sleep_timer, wake_at);
+			} else {
+				wakeups.push({ wake_at, current, NULL });
+			}
+
+			pick();
+		}
+
+		if (now >= next_tick) {
+			next_tick += options.tick_ns;
+
+			if (options.timer_wheel) {
+				uint64_t start = host_ns();
+				wheel.advance(now);
+				wheel_cost.push_back(host_ns() - start);
+			}
+
+			pick();
+		}
+	}
+
+	Result result;
+	result.threads = threads.size();
+	result.picks = pick_cost.size();
+	result.switches = switches;
+	result.locks = UniqueIRQLock::acquisitions;
+
+	result.voluntary = result.involuntary = 0;
+	for (auto stats = 0u; stats < SchedStats::nr_registered(); stats++) {
+		SchedStats *s = SchedStats::registered(stats);
+		if (strcmp(s->algorithm(), algorithm.name()) != 0) continue;
+
+		result.voluntary = s->counters.voluntary_switches;
+		result.involuntary = s->counters.involuntary_switches;
+	}
+
+	double pick_sum = 0;
+	for (auto cost : pick_cost) pick_sum += cost;
+	result.pick_mean_ns = pick_cost.empty() ? 0 : pick_sum / pick_cost.size();
+	result.pick_p99_ns = percentile(pick_cost, 99);
+
+	double wheel_sum = 0;
+	for (auto cost : wheel_cost) wheel_sum += cost;
+	result.wheel_mean_ns = wheel_cost.empty() ? 0 : wheel_sum / wheel_cost.size();
+
+	result.lat_p50_us = percentile(latency, 50) / 1000.0;
+	result.lat_p99_us = percentile(latency, 99) / 1000.0;
+	result.lat_max_us = latency.empty() ? 0 : *std::max_element(latency.begin(), latency.end()) / 1000.0;
+
+	result.fairness = fairness(threads, workload.classes.size());
+	result.utilisation = (double)busy / sys.runtime().count();
+
+	// Drain the runqueue, so the algorithm is empty for the next run.
+	for (auto thread : threads) {
+		wheel.cancel(thread->sleep_timer);
+		algorithm.remove_from_runqueue(*thread);
+	}
+	algorithm.pick_next_entity();
+
+	for (auto thread : threads) {
+		delete thread;
+	}
+
+	return result;
+}
+
+static void dump_stats()
+{
+	for (auto device : devices()) {
+		if (strcmp(device->device_class().name(), "sched-stats") != 0) continue;
+
+		CharacterDevice *chardev = (CharacterDevice *)device;
+		char buffer[512];
+		int n;
+
+		while ((n = chardev->read(buffer, sizeof(buffer))) > 0) {
+			fwrite(buffer, 1, n, stdout);
+		}
+	}
+}
+
+static void usage(const char *program)
+{
+	fprintf(stderr, "usage: %s [--duration-ms N] [--tick-us N] [--workload NAME] [--algorithm NAME] [--dump-stats] [--timer-wheel]\n", program);
+	fprintf(stderr, "workloads:");
+	for (const auto& workload : workloads) fprintf(stderr, " %s", workload.name);
+	fprintf(stderr, "\nalgorithms:");
+	for (auto algorithm : algorithms()) fprintf(stderr, " %s", algorithm->name());
+	fprintf(stderr, "\n");
+}
+
+int main(int argc, char **argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--duration-ms") == 0 && i + 1 < argc) {
+			options.duration_ns = strtoull(argv[++i], NULL, 0) * MS;
+		} else if (strcmp(argv[i], "--tick-us") == 0 && i + 1 < argc) {
+			options.tick_ns = strtoull(argv[++i], NULL, 0) * US;
+		} else if (strcmp(argv[i], "--workload") == 0 && i + 1 < argc) {
+			options.workload = argv[++i];
+		} else if (strcmp(argv[i], "--algorithm") == 0 && i + 1 < argc) {
+			options.algorithm = argv[++i];
+		} else if (strcmp(argv[i], "--dump-stats") == 0) {
+			options.dump_stats = true;
+		} else if (strcmp(argv[i], "--timer-wheel") == 0) {
+			options.timer_wheel = true;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (options.tick_ns == 0 || options.duration_ns == 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	printf("%-8s %-5s %7s %9s %9s %9s %9s %9s %9s %9s %9s %10s %10s %10s %8s %6s\n",
+			"workload", "alg", "threads", "picks", "pick-ns", "pick-p99", "wheel-ns",
+			"switches", "vol", "invol", "locks", "lat-p50us", "lat-p99us", "lat-maxus", "fairness", "util");
+
+	for (const auto& workload : workloads) {
+		if (options.workload && strcmp(options.workload, workload.name) != 0) continue;
+
+		for (auto algorithm : algorithms()) {
+			if (options.algorithm && strcmp(options.algorithm, algorithm->name()) != 0) continue;
+
+			Result r = simulate(*algorithm, workload, options);
+
+			printf("%-8s %-5s %7lu %9lu %9.1f %9.1f %9.1f %9lu %9lu %9lu %9lu %10.1f %10.1f %10.1f %8.4f %6.3f\n",
+					workload.name, algorithm->name(), r.threads, r.picks, r.pick_mean_ns, r.pick_p99_ns, r.wheel_mean_ns,
+					r.switches, r.voluntary, r.involuntary, r.locks, r.lat_p50_us, r.lat_p99_us, r.lat_max_us,
+					r.fairness, r.utilisation);
+
+			if (options.dump_stats) dump_stats();
+		}
+	}
+
+	return 0;
+}